@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <mutex>
 #include <list>
 #include <shared_mutex>
@@ -49,13 +50,30 @@ private:
       return mBucketData.end();
     }
   };
+  // the keys of findMany are resolved in groups of this size
+  static constexpr std::size_t sFindManyGroupSize = 16;
   std::vector<Bucket> mBuckets;
   Hash mHasher;
+  static void prefetch(const void* p) noexcept
+  {
+#if defined(__GNUC__)
+    __builtin_prefetch(p);
+#endif
+  }
   Bucket& getBucket(const Key& key);
   const Bucket& getBucket(const Key& key) const;
 public:
   FixedSizeThreadSafeHashMap(std::size_t bucketSize = 41, const Hash& hasher = Hash());
   std::optional<Value> find(const Key& val) const;
+  // calls fn(const Value&) with the value of key under the bucket lock instead of copying it out, returns false if key is absent.
+  // fn must not use the map.
+  template <typename F>
+  bool visit(const Key& key, F&& fn) const;
+  // looks up the keys in [first, last) and writes a std::optional<Value> per key to out, as find does for each of them.
+  // The bucket and lock lines of a group of keys are prefetched first without locking, so that the cache misses of independent keys overlap,
+  // then each bucket is searched under one shared lock. Only one bucket lock is held at a time.
+  template <typename ForwardIterator, typename OutputIterator>
+  OutputIterator findMany(ForwardIterator first, ForwardIterator last, OutputIterator out) const;
   void addOrUpdate(const Key& key, const Value& val);
   void remove(const Key& key);
   std::unordered_map<Key, Value, Hash> getSnapShot() const;
@@ -76,15 +94,50 @@ const typename FixedSizeThreadSafeHashMap<Key, Value, Hash>::Bucket& FixedSizeTh
 }
 template <typename Key, typename Value, typename Hash>
 std::optional<Value> FixedSizeThreadSafeHashMap<Key, Value, Hash>::find(const Key& key) const
+{
+  std::optional<Value> ans;
+  visit(key, [&ans](const Value& value){ ans = value; });
+  return ans;
+}
+template <typename Key, typename Value, typename Hash>
+template <typename F>
+bool FixedSizeThreadSafeHashMap<Key, Value, Hash>::visit(const Key& key, F&& fn) const
 {
   auto& bucket = getBucket(key);
   std::shared_lock lk(bucket.mLock);
   auto it = bucket.find(key);
   if(it == bucket.end())
   {
-    return std::nullopt;
+    return false;
+  }
+  fn(static_cast<const Value&>(it->second));
+  return true;
+}
+template <typename Key, typename Value, typename Hash>
+template <typename ForwardIterator, typename OutputIterator>
+OutputIterator FixedSizeThreadSafeHashMap<Key, Value, Hash>::findMany(ForwardIterator first, ForwardIterator last, OutputIterator out) const
+{
+  std::array<const Bucket*, sFindManyGroupSize> buckets;
+  while(first != last)
+  {
+    auto groupFirst = first;
+    std::size_t n = 0;
+    for(; n < sFindManyGroupSize && first != last; ++n, ++first)
+    {
+      buckets[n] = &getBucket(*first);
+      prefetch(&buckets[n]->mBucketData);
+      prefetch(&buckets[n]->mLock);
+    }
+    for(std::size_t i = 0; i < n; ++i, ++groupFirst)
+    {
+      auto& bucket = *buckets[i];
+      std::shared_lock lk(bucket.mLock);
+      auto it = bucket.find(*groupFirst);
+      *out = it != bucket.end() ? std::optional<Value>(it->second) : std::nullopt;
+      ++out;
+    }
   }
-  return it->second;
+  return out;
 }
 template <typename Key, typename Value, typename Hash>
 void FixedSizeThreadSafeHashMap<Key, Value, Hash>::addOrUpdate(const Key& key, const Value& val)
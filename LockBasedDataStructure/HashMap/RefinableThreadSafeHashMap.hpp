@@ -6,6 +6,7 @@
 #include <vector>
 #include <memory>
 #include "Finally.hpp"
+#include "ShardedCounter.hpp"
 
 namespace Detail
 {
@@ -275,14 +276,16 @@ private:
     using BucketIterator = typename BucketData::iterator;
     using ConstBucketIterator = typename BucketData::const_iterator;
     BucketData mBucketData;
-    ConstBucketIterator find(const Key& key) const
+    template <typename K>
+    ConstBucketIterator find(const K& key) const
     {
       return std::find_if(
         mBucketData.begin(),
         mBucketData.end(),
         [&key](auto&& val){ return val.first == key; });
     }
-    BucketIterator find(const Key& key)
+    template <typename K>
+    BucketIterator find(const K& key)
     {
       return std::find_if(
         mBucketData.begin(),
@@ -322,18 +325,35 @@ private:
   std::vector<Bucket> mBuckets;
   mutable std::atomic<std::vector<std::mutex>*> mLocks;
   std::atomic<bool> mRehash;
-  std::atomic<std::size_t> mSize;
+  ShardedCounter mSize;
   Hash mHasher; // TODO: EBO
   void rehash(std::unique_lock<std::mutex>& lock);
   std::unique_lock<std::mutex> acquire(HashValue hashValue) const;
   std::size_t getBucketIndex(HashValue hashValue) const;
+  template <typename K, typename F>
+  bool visitImpl(const K& key, F& fn) const;
+  template <typename K>
+  void removeImpl(const K& key);
   static void deleter(void* data);
 public:
   RefinableThreadSafeHashmap(std::size_t initialBucketSize = 41, const Hash& hash = Hash());
   ~RefinableThreadSafeHashmap();
   std::optional<Value> find(const Key& key) const;
+  // find and remove accept any key type comparable with Key if Hash::is_transparent is defined
+  template <typename K, typename H = Hash, typename = typename H::is_transparent>
+  std::optional<Value> find(const K& key) const;
+  // calls fn(const Value&) with the value of key under the bucket lock instead of copying it out, returns false if key is absent.
+  // fn must not use the map.
+  template <typename F>
+  bool visit(const Key& key, F&& fn) const;
+  template <typename K, typename F, typename H = Hash, typename = typename H::is_transparent>
+  bool visit(const K& key, F&& fn) const;
   void addOrUpdate(const Key& key, const Value& val);
+  // approximate while other threads modify the map
+  std::size_t size() const noexcept { return mSize.load(); }
   void remove(const Key& key);
+  template <typename K, typename H = Hash, typename = typename H::is_transparent>
+  void remove(const K& key);
 };
 
 template <typename Key, typename Value, typename Hash>
@@ -416,7 +436,7 @@ RefinableThreadSafeHashmap<Key, Value, Hash>::RefinableThreadSafeHashmap(std::si
   : mBuckets(initialBucketSize)
   , mLocks(new std::vector<std::mutex>(initialBucketSize))
   , mRehash(false)
-  , mSize(0)
+  , mSize()
   , mHasher(hasher)
 {
 }
@@ -428,13 +448,46 @@ RefinableThreadSafeHashmap<Key, Value, Hash>::~RefinableThreadSafeHashmap()
 }
 template <typename Key, typename Value, typename Hash>
 std::optional<Value> RefinableThreadSafeHashmap<Key, Value, Hash>::find(const Key& key) const
+{
+  std::optional<Value> ans;
+  visit(key, [&ans](const Value& value){ ans = value; });
+  return ans;
+}
+template <typename Key, typename Value, typename Hash>
+template <typename K, typename H, typename>
+std::optional<Value> RefinableThreadSafeHashmap<Key, Value, Hash>::find(const K& key) const
+{
+  std::optional<Value> ans;
+  visit(key, [&ans](const Value& value){ ans = value; });
+  return ans;
+}
+template <typename Key, typename Value, typename Hash>
+template <typename F>
+bool RefinableThreadSafeHashmap<Key, Value, Hash>::visit(const Key& key, F&& fn) const
+{
+  return visitImpl(key, fn);
+}
+template <typename Key, typename Value, typename Hash>
+template <typename K, typename F, typename H, typename>
+bool RefinableThreadSafeHashmap<Key, Value, Hash>::visit(const K& key, F&& fn) const
+{
+  return visitImpl(key, fn);
+}
+template <typename Key, typename Value, typename Hash>
+template <typename K, typename F>
+bool RefinableThreadSafeHashmap<Key, Value, Hash>::visitImpl(const K& key, F& fn) const
 {
   auto hashValue = mHasher(key);
   auto lock = acquire(hashValue);
   std::size_t index = getBucketIndex(hashValue);
   auto& bucket = mBuckets[index];
   auto it = bucket.find(key);
-  return it != bucket.end() ? std::optional<Value>(it->second) : std::nullopt;
+  if(it == bucket.end())
+  {
+    return false;
+  }
+  fn(static_cast<const Value&>(it->second));
+  return true;
 }
 template <typename Key, typename Value, typename Hash>
 void RefinableThreadSafeHashmap<Key, Value, Hash>::addOrUpdate(const Key& key, const Value& val)
@@ -448,8 +501,8 @@ void RefinableThreadSafeHashmap<Key, Value, Hash>::addOrUpdate(const Key& key, c
   if(it == bucket.end())
   {
     bucket.append(std::make_pair(key, val));
-    std::size_t curSize = mSize.fetch_add(1);
-    doRehash = (curSize / mBuckets.size() > sThreshold);
+    // the size is summed up only on sampled inserts, so a rehash may come up to ShardedCounter::sSampleInterval - 1 inserts per shard late
+    doRehash = mSize.addAndSample(1) && static_cast<std::size_t>(mSize.load()) / mBuckets.size() > sThreshold;
   }
   else
   {
@@ -466,6 +519,18 @@ void RefinableThreadSafeHashmap<Key, Value, Hash>::addOrUpdate(const Key& key, c
 }
 template <typename Key, typename Value, typename Hash>
 void RefinableThreadSafeHashmap<Key, Value, Hash>::remove(const Key& key)
+{
+  removeImpl(key);
+}
+template <typename Key, typename Value, typename Hash>
+template <typename K, typename H, typename>
+void RefinableThreadSafeHashmap<Key, Value, Hash>::remove(const K& key)
+{
+  removeImpl(key);
+}
+template <typename Key, typename Value, typename Hash>
+template <typename K>
+void RefinableThreadSafeHashmap<Key, Value, Hash>::removeImpl(const K& key)
 {
   auto hashValue = mHasher(key);
   auto lock = acquire(hashValue);
@@ -475,7 +540,7 @@ void RefinableThreadSafeHashmap<Key, Value, Hash>::remove(const Key& key)
   if(it != bucket.end())
   {
     bucket.remove(it);
-    mSize.fetch_sub(1);
+    mSize.add(-1);
   }
 }
 
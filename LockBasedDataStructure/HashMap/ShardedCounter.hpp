@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// Counter split into cache line sized shards, a thread always updates the same shard so that
+// threads updating the counter at the same time do not share a cache line unless there are more threads than shards.
+// load() sums up the shards without any synchronization, so it is exact only when no thread updates the counter.
+class ShardedCounter
+{
+private:
+  static constexpr std::size_t sMaxShardNum = 64;
+  struct alignas(64) Shard
+  {
+    std::atomic<std::int64_t> mValue{0};
+    std::atomic<std::uint64_t> mCalls{0}; // the calls of addAndSample on the shard
+  };
+  std::unique_ptr<Shard[]> mShards;
+  std::size_t mMask;
+  inline static std::atomic<std::size_t> sNextThreadIndex{0};
+  inline static thread_local std::size_t sThreadIndex = sNextThreadIndex.fetch_add(1, std::memory_order_relaxed);
+  static std::size_t getShardNum() noexcept
+  {
+    std::size_t threadNum = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t ans = 1;
+    while(ans < threadNum && ans < sMaxShardNum)
+    {
+      ans *= 2;
+    }
+    return ans;
+  }
+  Shard& getShard() noexcept
+  {
+    return mShards[sThreadIndex & mMask];
+  }
+public:
+  // addAndSample returns true once in this many calls on a shard
+  static constexpr std::uint64_t sSampleInterval = 64;
+  ShardedCounter(): mShards(new Shard[getShardNum()]), mMask(getShardNum() - 1) {}
+  ShardedCounter(const ShardedCounter&) = delete;
+  ShardedCounter& operator=(const ShardedCounter&) = delete;
+  // stronger orders let the counter track operations in flight, e.g. release on the decrement and acquire on load()
+  void add(std::int64_t n, std::memory_order order = std::memory_order_relaxed) noexcept
+  {
+    getShard().mValue.fetch_add(n, order);
+  }
+  // adds n and tells whether the caller should check a threshold on load(), which is too expensive to call on every update.
+  // The calls are sampled regardless of the value, so that a thread which mostly decrements does not sample every call.
+  // Even a small counter is only sampled every sSampleInterval calls on a shard, so a threshold may be checked up to
+  // sSampleInterval - 1 updates per shard late, i.e. about 4000 updates in total with 64 shards, and a little later if calls are lost.
+  bool addAndSample(std::int64_t n) noexcept
+  {
+    auto& shard = getShard();
+    shard.mValue.fetch_add(n, std::memory_order_relaxed);
+    // not an RMW, threads which share the shard may lose a count, which only delays a sample
+    auto calls = shard.mCalls.load(std::memory_order_relaxed) + 1;
+    shard.mCalls.store(calls, std::memory_order_relaxed);
+    return calls % sSampleInterval == 0;
+  }
+  // approximate value, it is never negative though the shards may be.
+  std::int64_t load(std::memory_order order = std::memory_order_relaxed) const noexcept
+  {
+    std::int64_t ans = 0;
+    for(std::size_t i = 0; i <= mMask; ++i)
+    {
+      ans += mShards[i].mValue.load(order);
+    }
+    return std::max<std::int64_t>(ans, 0);
+  }
+};
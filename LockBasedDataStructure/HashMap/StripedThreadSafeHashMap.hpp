@@ -8,6 +8,7 @@
 #include <optional>
 #include <cassert>
 #include "Finally.hpp"
+#include "ShardedCounter.hpp"
 
 template <typename Key, typename Value, typename Hash = std::hash<Key>>
 class StripedThreadSafeHashmap
@@ -21,14 +22,16 @@ private:
     using BucketIterator = typename BucketData::iterator;
     using ConstBucketIterator = typename BucketData::const_iterator;
     BucketData mBucketData;
-    ConstBucketIterator find(const Key& key) const
+    template <typename K>
+    ConstBucketIterator find(const K& key) const
     {
       return std::find_if(
         mBucketData.begin(),
         mBucketData.end(),
         [&key](auto&& val){ return val.first == key; });
     }
-    BucketIterator find(const Key& key)
+    template <typename K>
+    BucketIterator find(const K& key)
     {
       return std::find_if(
         mBucketData.begin(),
@@ -67,15 +70,32 @@ private:
   using HashValue = decltype(std::declval<Hash>()(std::declval<const Key&>()));
   std::vector<Bucket> mBuckets;
   mutable std::vector<std::mutex> mLocks;
-  std::atomic<std::size_t> mSize;
+  ShardedCounter mSize;
   Hash mHasher; // TODO: EBO
   void rehash(std::unique_lock<std::mutex>& lock);
   std::unique_lock<std::mutex> acquire(HashValue hashValue) const;
   std::size_t getBucketIndex(HashValue hashValue) const;
+  template <typename K, typename F>
+  bool visitImpl(const K& key, F& fn) const;
+  template <typename K>
+  void removeImpl(const K& key);
 public: StripedThreadSafeHashmap(std::size_t initialBucketSize = 41, const Hash& hasher = Hash());
   std::optional<Value> find(const Key& key) const;
+  // find and remove accept any key type comparable with Key if Hash::is_transparent is defined
+  template <typename K, typename H = Hash, typename = typename H::is_transparent>
+  std::optional<Value> find(const K& key) const;
+  // calls fn(const Value&) with the value of key under the bucket lock instead of copying it out, returns false if key is absent.
+  // fn must not use the map.
+  template <typename F>
+  bool visit(const Key& key, F&& fn) const;
+  template <typename K, typename F, typename H = Hash, typename = typename H::is_transparent>
+  bool visit(const K& key, F&& fn) const;
   void addOrUpdate(const Key& key, const Value& val);
+  // approximate while other threads modify the map
+  std::size_t size() const noexcept { return mSize.load(); }
   void remove(const Key& key);
+  template <typename K, typename H = Hash, typename = typename H::is_transparent>
+  void remove(const K& key);
 };
 
 template <typename Key, typename Value, typename Hash>
@@ -131,19 +151,52 @@ template <typename Key, typename Value, typename Hash>
 StripedThreadSafeHashmap<Key, Value, Hash>::StripedThreadSafeHashmap(std::size_t initialBucketSize, const Hash& hasher)
   : mBuckets(initialBucketSize)
   , mLocks(initialBucketSize)
-  , mSize(0)
+  , mSize()
   , mHasher(hasher)
 {
 }
 template <typename Key, typename Value, typename Hash>
 std::optional<Value> StripedThreadSafeHashmap<Key, Value, Hash>::find(const Key& key) const
+{
+  std::optional<Value> ans;
+  visit(key, [&ans](const Value& value){ ans = value; });
+  return ans;
+}
+template <typename Key, typename Value, typename Hash>
+template <typename K, typename H, typename>
+std::optional<Value> StripedThreadSafeHashmap<Key, Value, Hash>::find(const K& key) const
+{
+  std::optional<Value> ans;
+  visit(key, [&ans](const Value& value){ ans = value; });
+  return ans;
+}
+template <typename Key, typename Value, typename Hash>
+template <typename F>
+bool StripedThreadSafeHashmap<Key, Value, Hash>::visit(const Key& key, F&& fn) const
+{
+  return visitImpl(key, fn);
+}
+template <typename Key, typename Value, typename Hash>
+template <typename K, typename F, typename H, typename>
+bool StripedThreadSafeHashmap<Key, Value, Hash>::visit(const K& key, F&& fn) const
+{
+  return visitImpl(key, fn);
+}
+template <typename Key, typename Value, typename Hash>
+template <typename K, typename F>
+bool StripedThreadSafeHashmap<Key, Value, Hash>::visitImpl(const K& key, F& fn) const
 {
   auto hashValue = mHasher(key);
   auto lock = acquire(hashValue);
   std::size_t index = getBucketIndex(hashValue);
   auto& bucket = mBuckets[index];
   auto it = bucket.find(key);
-  return it != bucket.end() ? std::optional<Value>(it->second) : std::nullopt;
+  if(it == bucket.end())
+  {
+    return false;
+  }
+  fn(static_cast<const Value&>(it->second));
+  return true;
 }
 template <typename Key, typename Value, typename Hash>
 void StripedThreadSafeHashmap<Key, Value, Hash>::addOrUpdate(const Key& key, const Value& val)
@@ -157,8 +210,8 @@ void StripedThreadSafeHashmap<Key, Value, Hash>::addOrUpdate(const Key& key, con
   if(it == bucket.end())
   {
     bucket.append(std::make_pair(key, val));
-    std::size_t curSize = mSize.fetch_add(1);
-    doRehash = (curSize / mBuckets.size() > sThreshold);
+    // the size is summed up only on sampled inserts, so a rehash may come up to ShardedCounter::sSampleInterval - 1 inserts per shard late
+    doRehash = mSize.addAndSample(1) && static_cast<std::size_t>(mSize.load()) / mBuckets.size() > sThreshold;
   }
   else
   {
@@ -175,6 +228,18 @@ void StripedThreadSafeHashmap<Key, Value, Hash>::addOrUpdate(const Key& key, con
 }
 template <typename Key, typename Value, typename Hash>
 void StripedThreadSafeHashmap<Key, Value, Hash>::remove(const Key& key)
+{
+  removeImpl(key);
+}
+template <typename Key, typename Value, typename Hash>
+template <typename K, typename H, typename>
+void StripedThreadSafeHashmap<Key, Value, Hash>::remove(const K& key)
+{
+  removeImpl(key);
+}
+template <typename Key, typename Value, typename Hash>
+template <typename K>
+void StripedThreadSafeHashmap<Key, Value, Hash>::removeImpl(const K& key)
 {
   auto hashValue = mHasher(key);
   auto lock = acquire(hashValue);
@@ -184,7 +249,7 @@ void StripedThreadSafeHashmap<Key, Value, Hash>::remove(const Key& key)
   if(it != bucket.end())
   {
     bucket.remove(it);
-    mSize.fetch_sub(1);
+    mSize.add(-1);
   }
 }
 
@@ -7,11 +7,22 @@
 #include <string>
 #include <future>
 #include <vector>
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <optional>
 #include <random>
+#include <string_view>
 #include "FixedSizeThreadSafeHashMap.hpp"
 #include "StripedThreadSafeHashMap.hpp"
 #include "RefinableThreadSafeHashMap.hpp"
 
+struct TransparentStringHash
+{
+  using is_transparent = void;
+  std::size_t operator()(std::string_view str) const noexcept { return std::hash<std::string_view>()(str); }
+};
+
 class jthread
 {
 private:
@@ -74,6 +85,41 @@ BOOST_AUTO_TEST_CASE(TestFixedSizeThreadSafeHashMap)
   });
 }
 
+BOOST_AUTO_TEST_CASE(TestFixedSizeThreadSafeHashMapFindMany)
+{
+  FixedSizeThreadSafeHashMap<int, int> map;
+  for(int i = 0; i < 1000; i += 2)
+  {
+    map.addOrUpdate(i, i);
+  }
+  // the odd keys are updated while the batches are looked up, the even ones never change
+  jthread writer([&map]{
+    for(int i = 1; i < 1000; i += 2)
+    {
+      map.addOrUpdate(i, i);
+    }
+  });
+  std::vector<int> keys(1000);
+  std::iota(keys.begin(), keys.end(), 0);
+  for(int round = 0; round < 10; ++round)
+  {
+    std::vector<std::optional<int>> values;
+    map.findMany(keys.begin(), keys.end(), std::back_inserter(values));
+    BOOST_REQUIRE_EQUAL(values.size(), keys.size());
+    for(int i = 0; i < 1000; ++i)
+    {
+      if(i % 2 == 0)
+      {
+        BOOST_CHECK(values[i] == i);
+      }
+      else
+      {
+        BOOST_CHECK(!values[i] || *values[i] == i);
+      }
+    }
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestStripedThreadSafeHashmap)
 {
   StripedThreadSafeHashmap<int, int> map;
@@ -230,3 +276,59 @@ BOOST_AUTO_TEST_CASE(TestRefinableThreadSafeHashmap)
   }
 }
 
+
+template <typename Map>
+void testHeterogeneousLookup()
+{
+  Map map;
+  map.addOrUpdate("foo", 1);
+  map.addOrUpdate("bar", 2);
+  auto res = map.find(std::string_view("foo"));
+  BOOST_REQUIRE(res.has_value());
+  BOOST_CHECK_EQUAL(*res, 1);
+  BOOST_CHECK(!map.find(std::string_view("baz")).has_value());
+  map.remove(std::string_view("foo"));
+  BOOST_CHECK(!map.find(std::string("foo")).has_value());
+  BOOST_CHECK_EQUAL(*map.find(std::string_view("bar")), 2);
+  int value = 0;
+  BOOST_CHECK(map.visit(std::string_view("bar"), [&value](const int& v){ value = v; }));
+  BOOST_CHECK_EQUAL(value, 2);
+  BOOST_CHECK(!map.visit(std::string_view("foo"), [](const int&){ BOOST_ERROR("absent key is visited"); }));
+}
+
+template <typename Map>
+void testVisit()
+{
+  Map map;
+  map.addOrUpdate(0, std::vector<int>(1000, 7));
+  std::size_t size = 0;
+  BOOST_CHECK(map.visit(0, [&size](const std::vector<int>& value){ size = value.size(); }));
+  BOOST_CHECK_EQUAL(size, 1000u);
+  BOOST_CHECK(!map.visit(1, [](const std::vector<int>&){ BOOST_ERROR("absent key is visited"); }));
+  // the bucket lock keeps the value whole while another thread replaces it
+  jthread writer([&map]{
+    for(int i = 0; i < 1000; ++i)
+    {
+      map.addOrUpdate(0, std::vector<int>(1000, i));
+    }
+  });
+  int errors = 0;
+  for(int i = 0; i < 1000; ++i)
+  {
+    map.visit(0, [&errors](const std::vector<int>& value){ errors += std::count(value.begin(), value.end(), value.front()) != 1000; });
+  }
+  BOOST_CHECK_EQUAL(errors, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestVisit)
+{
+  testVisit<FixedSizeThreadSafeHashMap<int, std::vector<int>>>();
+  testVisit<StripedThreadSafeHashmap<int, std::vector<int>>>();
+  testVisit<RefinableThreadSafeHashmap<int, std::vector<int>>>();
+}
+
+BOOST_AUTO_TEST_CASE(TestHeterogeneousLookup)
+{
+  testHeterogeneousLookup<StripedThreadSafeHashmap<std::string, int, TransparentStringHash>>();
+  testHeterogeneousLookup<RefinableThreadSafeHashmap<std::string, int, TransparentStringHash>>();
+}
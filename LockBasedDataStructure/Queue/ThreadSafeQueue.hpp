@@ -107,7 +107,7 @@ template <typename T>
 bool ThreadSafeQueue<T>::tryPop(T& val)
 {
   auto head = tryPopHead(val);
-  return head;
+  return head != nullptr;
 }
 template <typename T>
 std::shared_ptr<T> ThreadSafeQueue<T>::waitAndPop()
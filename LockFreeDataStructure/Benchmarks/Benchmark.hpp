@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Benchmark
+{
+struct Options
+{
+  std::vector<std::size_t> mThreadNums;
+  std::chrono::milliseconds mDuration;
+};
+
+// usage: <program> [max thread num] [duration in milliseconds]
+inline Options parseOptions(int argc, char** argv)
+{
+  std::size_t maxThreadNum = std::max(2u, std::thread::hardware_concurrency());
+  long long duration = 500;
+  if(1 < argc)
+  {
+    maxThreadNum = std::strtoull(argv[1], nullptr, 10);
+  }
+  if(2 < argc)
+  {
+    duration = std::strtoll(argv[2], nullptr, 10);
+  }
+  Options options{{}, std::chrono::milliseconds(duration)};
+  for(std::size_t i = 1; i < maxThreadNum; i *= 2)
+  {
+    options.mThreadNums.push_back(i);
+  }
+  options.mThreadNums.push_back(maxThreadNum);
+  return options;
+}
+
+// Runs fn(threadIndex, stopFlag) on threadNum threads for the given duration.
+// fn returns the number of operations it has done and it has to poll stopFlag.
+// Returns the throughput in million operations per second.
+template <typename Fn>
+double run(std::size_t threadNum, std::chrono::milliseconds duration, Fn fn)
+{
+  std::promise<void> start;
+  auto startFut = start.get_future().share();
+  std::atomic<bool> stop(false);
+  std::vector<std::future<void>> ready;
+  std::vector<std::future<std::uint64_t>> done;
+  for(std::size_t i = 0; i < threadNum; ++i)
+  {
+    std::promise<void> p;
+    ready.push_back(p.get_future());
+    done.push_back(std::async(std::launch::async, [i, p = std::move(p), startFut, &stop, &fn]() mutable {
+      p.set_value();
+      startFut.wait();
+      return static_cast<std::uint64_t>(fn(i, stop));
+    }));
+  }
+  for(auto& fut: ready)
+  {
+    fut.wait();
+  }
+  auto begin = std::chrono::steady_clock::now();
+  start.set_value();
+  std::this_thread::sleep_for(duration);
+  stop.store(true, std::memory_order_relaxed);
+  std::uint64_t ops = 0;
+  for(auto& fut: done)
+  {
+    ops += fut.get();
+  }
+  auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+  return ops / elapsed;
+}
+
+inline void printHeader(const std::string& title, const std::vector<std::string>& columns, const std::string& unit = "Mops/s")
+{
+  std::cout << "# " << title << " [" << unit << "]" << std::endl;
+  std::cout << std::setw(8) << "threads";
+  for(auto& col: columns)
+  {
+    std::cout << std::setw(16) << col;
+  }
+  std::cout << std::endl;
+}
+
+inline void printRow(std::size_t threadNum, const std::vector<double>& values)
+{
+  std::cout << std::setw(8) << threadNum;
+  for(auto val: values)
+  {
+    std::cout << std::setw(16) << std::fixed << std::setprecision(3) << val;
+  }
+  std::cout << std::endl;
+}
+
+// xorshift, cheap enough not to dominate the measured operations
+class Random
+{
+private:
+  std::uint64_t mState;
+public:
+  explicit Random(std::uint64_t seed) noexcept: mState(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+  std::uint64_t operator()() noexcept
+  {
+    mState ^= mState << 13;
+    mState ^= mState >> 7;
+    mState ^= mState << 17;
+    return mState;
+  }
+};
+
+// Zipfian distribution over [0, n) by the algorithm of YCSB (Gray et al.), key 0 is the most popular.
+// The constructor sums n terms, so share one instance and copy it per thread.
+class Zipfian
+{
+private:
+  std::uint64_t mN;
+  double mTheta;
+  double mAlpha;
+  double mZetaN;
+  double mEta;
+  static double zeta(std::uint64_t n, double theta)
+  {
+    double sum = 0;
+    for(std::uint64_t i = 1; i <= n; ++i)
+    {
+      sum += 1 / std::pow(static_cast<double>(i), theta);
+    }
+    return sum;
+  }
+public:
+  explicit Zipfian(std::uint64_t n, double theta = 0.99)
+    : mN(n)
+    , mTheta(theta)
+    , mAlpha(1 / (1 - theta))
+    , mZetaN(zeta(n, theta))
+    , mEta((1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta(2, theta) / mZetaN))
+  {
+  }
+  std::uint64_t operator()(Random& rnd) const noexcept
+  {
+    auto u = static_cast<double>(rnd() >> 11) / static_cast<double>(1ULL << 53);
+    auto uz = u * mZetaN;
+    if(uz < 1)
+    {
+      return 0;
+    }
+    if(uz < 1 + std::pow(0.5, mTheta))
+    {
+      return 1;
+    }
+    return std::min(mN - 1, static_cast<std::uint64_t>(mN * std::pow(mEta * u - mEta + 1, mAlpha)));
+  }
+};
+}
@@ -0,0 +1,65 @@
+#include <iostream>
+#include <random>
+#include "Benchmark.hpp"
+#include "LockFreeHashMap.hpp"
+
+namespace
+{
+constexpr int sNumElements = 1 << 21;
+
+// returns million elements loaded per second
+template <typename Fn>
+double measure(Fn fn)
+{
+  auto begin = std::chrono::steady_clock::now();
+  fn();
+  auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+  return sNumElements / elapsed;
+}
+
+double insertEach(std::size_t threadNum, const std::vector<std::pair<int, int>>& elems)
+{
+  return measure([threadNum, &elems]() {
+    LockFreeHashMap<int, int> map;
+    std::vector<std::future<void>> done;
+    for(std::size_t i = 0; i < threadNum; ++i)
+    {
+      done.push_back(std::async(std::launch::async, [i, threadNum, &map, &elems]() {
+        for(auto j = elems.size() * i / threadNum; j < elems.size() * (i + 1) / threadNum; ++j)
+        {
+          map.insert(elems[j]);
+        }
+      }));
+    }
+    for(auto& fut: done)
+    {
+      fut.get();
+    }
+  });
+}
+
+double bulkLoad(std::size_t threadNum, const std::vector<std::pair<int, int>>& elems)
+{
+  return measure([threadNum, &elems]() {
+    LockFreeHashMap<int, int> map(elems.begin(), elems.end(), threadNum);
+  });
+}
+}
+
+// the duration option is not used, each column loads sNumElements elements into an empty map once.
+int main(int argc, char** argv)
+{
+  auto options = Benchmark::parseOptions(argc, argv);
+  std::vector<std::pair<int, int>> elems;
+  for(int i = 0; i < sNumElements; ++i)
+  {
+    elems.emplace_back(i, i);
+  }
+  std::shuffle(elems.begin(), elems.end(), std::mt19937(42));
+  Benchmark::printHeader("LockFreeHashMap warm start", {"insert", "bulk load"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    Benchmark::printRow(threadNum, {insertEach(threadNum, elems), bulkLoad(threadNum, elems)});
+  }
+  return 0;
+}
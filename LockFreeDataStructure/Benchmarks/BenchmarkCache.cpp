@@ -0,0 +1,125 @@
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include "Benchmark.hpp"
+#include "ConcurrentCache.hpp"
+
+namespace
+{
+constexpr std::uint64_t sKeyRange = 1 << 20;
+constexpr std::size_t sCapacity = 1 << 16;
+constexpr std::size_t sKeysPerThread = 1 << 20;
+
+// the baseline, exact LRU order under a single lock
+template <typename Key, typename Value>
+class MutexLruCache
+{
+private:
+  using List = std::list<std::pair<Key, Value>>;
+  List mList; // the most recently used entry first
+  std::unordered_map<Key, typename List::iterator> mIndex;
+  std::size_t mCapacity;
+  std::mutex mMutex;
+public:
+  explicit MutexLruCache(std::size_t capacity): mCapacity(capacity) {}
+  std::optional<Value> get(const Key& key)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mIndex.find(key);
+    if(it == mIndex.end())
+    {
+      return std::nullopt;
+    }
+    mList.splice(mList.begin(), mList, it->second);
+    return it->second->second;
+  }
+  void put(const Key& key, const Value& value)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mIndex.find(key);
+    if(it != mIndex.end())
+    {
+      it->second->second = value;
+      mList.splice(mList.begin(), mList, it->second);
+      return;
+    }
+    mList.emplace_front(key, value);
+    mIndex.emplace(key, mList.begin());
+    if(mCapacity < mList.size())
+    {
+      mIndex.erase(mList.back().first);
+      mList.pop_back();
+    }
+  }
+};
+
+struct Result
+{
+  double mThroughput;
+  double mHitRatio;
+};
+
+// cache-aside reads of Zipfian keys, a miss puts the key. The keys are drawn beforehand so that the generator is not measured.
+template <typename Cache>
+Result zipfianGetOrPut(std::size_t threadNum, std::chrono::milliseconds duration, const Benchmark::Zipfian& zipfian)
+{
+  Cache cache(sCapacity);
+  std::vector<std::vector<std::uint64_t>> keys(threadNum);
+  for(std::size_t i = 0; i < threadNum; ++i)
+  {
+    Benchmark::Random rnd(i + 1);
+    for(std::size_t j = 0; j < sKeysPerThread; ++j)
+    {
+      // scatter the popular keys over the key range, an odd multiplier is a bijection modulo a power of 2
+      keys[i].push_back(zipfian(rnd) * 0x9E3779B97F4A7C15ULL % sKeyRange);
+    }
+  }
+  std::atomic<std::uint64_t> hits(0);
+  std::atomic<std::uint64_t> total(0);
+  auto throughput = Benchmark::run(threadNum, duration, [&cache, &keys, &hits, &total](std::size_t id, const std::atomic<bool>& stop) {
+    auto& myKeys = keys[id];
+    std::uint64_t ops = 0;
+    std::uint64_t myHits = 0;
+    while(!stop.load(std::memory_order_relaxed))
+    {
+      auto key = myKeys[ops % sKeysPerThread];
+      if(cache.get(key))
+      {
+        ++myHits;
+      }
+      else
+      {
+        cache.put(key, key);
+      }
+      ++ops;
+    }
+    hits.fetch_add(myHits);
+    total.fetch_add(ops);
+    return ops;
+  });
+  return {throughput, total.load() ? static_cast<double>(hits.load()) / total.load() : 0};
+}
+}
+
+int main(int argc, char** argv)
+{
+  auto options = Benchmark::parseOptions(argc, argv);
+  Benchmark::Zipfian zipfian(sKeyRange);
+  std::vector<std::vector<double>> hitRatios;
+  Benchmark::printHeader("Zipfian(0.99) get-or-put, 64Ki entries of 1Mi keys", {"Clock", "MutexLru"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    auto clock = zipfianGetOrPut<ConcurrentCache<std::uint64_t, std::uint64_t>>(threadNum, options.mDuration, zipfian);
+    auto lru = zipfianGetOrPut<MutexLruCache<std::uint64_t, std::uint64_t>>(threadNum, options.mDuration, zipfian);
+    Benchmark::printRow(threadNum, {clock.mThroughput, lru.mThroughput});
+    hitRatios.push_back({clock.mHitRatio, lru.mHitRatio});
+  }
+  Benchmark::printHeader("hit ratio of the runs above", {"Clock", "MutexLru"}, "hits/gets");
+  for(std::size_t i = 0; i < hitRatios.size(); ++i)
+  {
+    Benchmark::printRow(options.mThreadNums[i], hitRatios[i]);
+  }
+  return 0;
+}
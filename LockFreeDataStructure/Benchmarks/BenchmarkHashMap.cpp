@@ -0,0 +1,102 @@
+#include <iostream>
+#include <optional>
+#include <vector>
+#include "Benchmark.hpp"
+#include "LockFreeHashMap.hpp"
+#include "LockFreeOpenAddressingHashMap.hpp"
+
+namespace
+{
+constexpr std::int64_t sKeyRange = 1 << 20;
+
+// 90% find, 5% insert, 5% remove on a map which holds about half of the key range
+template <typename Map>
+double readHeavy(std::size_t threadNum, std::chrono::milliseconds duration, Map& map)
+{
+  for(std::int64_t i = 0; i < sKeyRange; i += 2)
+  {
+    map.insert({i, i});
+  }
+  return Benchmark::run(threadNum, duration, [&map](std::size_t id, const std::atomic<bool>& stop) {
+    Benchmark::Random rnd(id);
+    std::uint64_t ops = 0;
+    while(!stop.load(std::memory_order_relaxed))
+    {
+      auto r = rnd();
+      auto key = static_cast<std::int64_t>(r % sKeyRange);
+      auto op = (r >> 32) % 100;
+      if(op < 90)
+      {
+        map.find(key);
+      }
+      else if(op < 95)
+      {
+        map.insert({key, key});
+      }
+      else
+      {
+        map.remove(key);
+      }
+      ++ops;
+    }
+    return ops;
+  });
+}
+
+// lookups of random batches of sBatchSize keys in a map which holds the whole key range, one operation is one key
+constexpr std::size_t sBatchSize = 64;
+template <typename Map, typename Lookup>
+double batchLookup(std::size_t threadNum, std::chrono::milliseconds duration, Map& map, Lookup lookup)
+{
+  return Benchmark::run(threadNum, duration, [&map, &lookup](std::size_t id, const std::atomic<bool>& stop) {
+    Benchmark::Random rnd(id);
+    std::vector<std::int64_t> keys(sBatchSize);
+    std::vector<std::optional<std::int64_t>> values(sBatchSize);
+    std::uint64_t ops = 0;
+    while(!stop.load(std::memory_order_relaxed))
+    {
+      for(auto& key: keys)
+      {
+        key = static_cast<std::int64_t>(rnd() % sKeyRange);
+      }
+      lookup(map, keys, values);
+      ops += sBatchSize;
+    }
+    return ops;
+  });
+}
+}
+
+int main(int argc, char** argv)
+{
+  auto options = Benchmark::parseOptions(argc, argv);
+  Benchmark::printHeader("90% find / 5% insert / 5% remove", {"LockFree", "OpenAddressing"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    LockFreeHashMap<std::int64_t, std::int64_t> lockFreeMap;
+    LockFreeOpenAddressingHashMap<std::int64_t, std::int64_t> openAddressingMap(sKeyRange);
+    Benchmark::printRow(threadNum, {
+      readHeavy(threadNum, options.mDuration, lockFreeMap),
+      readHeavy(threadNum, options.mDuration, openAddressingMap)});
+  }
+  Benchmark::printHeader("lookups of 64 random keys per batch", {"find", "findMany"}, "Mkeys/s");
+  LockFreeHashMap<std::int64_t, std::int64_t> map;
+  for(std::int64_t i = 0; i < sKeyRange; ++i)
+  {
+    map.insert({i, i});
+  }
+  for(auto threadNum: options.mThreadNums)
+  {
+    Benchmark::printRow(threadNum, {
+      batchLookup(threadNum, options.mDuration, map, [](auto& m, auto& keys, auto& values) {
+        for(std::size_t i = 0; i < keys.size(); ++i)
+        {
+          values[i] = m.find(keys[i]);
+        }
+      }),
+      batchLookup(threadNum, options.mDuration, map, [](auto& m, auto& keys, auto& values) {
+        m.findMany(keys.begin(), keys.end(), values.begin());
+      })});
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include "Benchmark.hpp"
+#include "HazardPointer.hpp"
+#include "EpochBasedReclamation.hpp"
+#include "NodePool.hpp"
+#include "LockFreeHashMap.hpp"
+#include "MSQueue.hpp"
+#include "LockFreeStack.hpp"
+
+namespace
+{
+constexpr int sKeyRange = 1 << 16;
+
+// 50% insert, 50% remove, every successful operation allocates or frees a node
+template <typename NodeAllocator>
+double churnHashMap(std::size_t threadNum, std::chrono::milliseconds duration)
+{
+  LockFreeHashMap<int, int, std::hash<int>, 1 << 10, EpochDomain, NodeAllocator> map;
+  for(int i = 0; i < sKeyRange; i += 2)
+  {
+    map.insert({i, i});
+  }
+  return Benchmark::run(threadNum, duration, [&map](std::size_t id, const std::atomic<bool>& stop) {
+    Benchmark::Random rnd(id);
+    std::uint64_t ops = 0;
+    while(!stop.load(std::memory_order_relaxed))
+    {
+      auto r = rnd();
+      auto key = static_cast<int>(r % sKeyRange);
+      if((r >> 32) & 1)
+      {
+        map.insert({key, key});
+      }
+      else
+      {
+        map.remove(key);
+      }
+      ++ops;
+    }
+    return ops;
+  });
+}
+
+// nodes pushed by a thread are mostly popped and freed by another one
+template <typename NodeAllocator>
+double pushPopQueue(std::size_t threadNum, std::chrono::milliseconds duration)
+{
+  MSQueue<int, EpochDomain, NodeAllocator> queue;
+  return Benchmark::run(threadNum, duration, [&queue](std::size_t id, const std::atomic<bool>& stop) {
+    std::uint64_t ops = 0;
+    while(!stop.load(std::memory_order_relaxed))
+    {
+      queue.push(static_cast<int>(id));
+      queue.tryPop();
+      ops += 2;
+    }
+    return ops;
+  });
+}
+
+template <typename NodeAllocator>
+double pushPopStack(std::size_t threadNum, std::chrono::milliseconds duration)
+{
+  LockFreeStack<int, EpochDomain, NodeAllocator> stack;
+  return Benchmark::run(threadNum, duration, [&stack](std::size_t id, const std::atomic<bool>& stop) {
+    std::uint64_t ops = 0;
+    while(!stop.load(std::memory_order_relaxed))
+    {
+      stack.push(static_cast<int>(id));
+      stack.pop();
+      ops += 2;
+    }
+    return ops;
+  });
+}
+}
+
+int main(int argc, char** argv)
+{
+  auto options = Benchmark::parseOptions(argc, argv);
+  Benchmark::printHeader("LockFreeHashMap 50% insert / 50% remove", {"new/delete", "NodePool"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    Benchmark::printRow(threadNum, {
+      churnHashMap<NewDeleteNodeAllocator>(threadNum, options.mDuration),
+      churnHashMap<PoolNodeAllocator>(threadNum, options.mDuration)});
+  }
+  Benchmark::printHeader("MSQueue push / tryPop", {"new/delete", "NodePool"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    Benchmark::printRow(threadNum, {
+      pushPopQueue<NewDeleteNodeAllocator>(threadNum, options.mDuration),
+      pushPopQueue<PoolNodeAllocator>(threadNum, options.mDuration)});
+  }
+  Benchmark::printHeader("LockFreeStack push / pop", {"new/delete", "NodePool"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    Benchmark::printRow(threadNum, {
+      pushPopStack<NewDeleteNodeAllocator>(threadNum, options.mDuration),
+      pushPopStack<PoolNodeAllocator>(threadNum, options.mDuration)});
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <thread>
+#include "Benchmark.hpp"
+#include "BoundedMPMCQueue.hpp"
+#include "MSQueue.hpp"
+#include "SegmentedQueue.hpp"
+#include "ThreadSafeQueue.hpp"
+
+namespace
+{
+constexpr std::size_t sCapacity = 1 << 10;
+
+// the queues have different interfaces, a push may fail only on the bounded queue
+bool tryPush(BoundedMPMCQueue<std::uint64_t>& queue, std::uint64_t value) { return queue.tryPush(value); }
+bool tryPush(MSQueue<std::uint64_t>& queue, std::uint64_t value) { queue.push(value); return true; }
+bool tryPush(SegmentedQueue<std::uint64_t>& queue, std::uint64_t value) { queue.push(value); return true; }
+bool tryPush(ThreadSafeQueue<std::uint64_t>& queue, std::uint64_t value) { queue.push(value); return true; }
+bool tryPop(BoundedMPMCQueue<std::uint64_t>& queue, std::uint64_t& value) { return queue.tryPop(value); }
+bool tryPop(MSQueue<std::uint64_t>& queue, std::uint64_t& value) { return queue.tryPop(value); }
+bool tryPop(SegmentedQueue<std::uint64_t>& queue, std::uint64_t& value) { return queue.tryPop(value); }
+bool tryPop(ThreadSafeQueue<std::uint64_t>& queue, std::uint64_t& value) { return queue.tryPop(value); }
+
+template <typename Queue>
+std::unique_ptr<Queue> makeQueue()
+{
+  if constexpr(std::is_same_v<Queue, BoundedMPMCQueue<std::uint64_t>>)
+  {
+    return std::make_unique<Queue>(sCapacity);
+  }
+  else
+  {
+    return std::make_unique<Queue>();
+  }
+}
+
+// every thread pushes and pops in turn, one operation is a pair
+template <typename Queue>
+double pairs(std::size_t threadNum, std::chrono::milliseconds duration)
+{
+  auto queue = makeQueue<Queue>();
+  return Benchmark::run(threadNum, duration, [&queue](std::size_t id, const std::atomic<bool>& stop) {
+    std::uint64_t ops = 0;
+    std::uint64_t value;
+    while(!stop.load(std::memory_order_relaxed))
+    {
+      tryPush(*queue, ops);
+      tryPop(*queue, value);
+      ++ops;
+    }
+    return ops;
+  });
+}
+
+// half of the threads only push and the other half only pop, one operation is a popped element
+template <typename Queue>
+double producerConsumer(std::size_t threadNum, std::chrono::milliseconds duration)
+{
+  auto queue = makeQueue<Queue>();
+  return Benchmark::run(threadNum, duration, [&queue](std::size_t id, const std::atomic<bool>& stop) {
+    std::uint64_t ops = 0;
+    if(id % 2 == 0)
+    {
+      for(std::uint64_t i = 0; !stop.load(std::memory_order_relaxed); )
+      {
+        if(tryPush(*queue, i))
+        {
+          ++i;
+        }
+        else
+        {
+          // the queue is full, let a consumer run
+          std::this_thread::yield();
+        }
+      }
+      return ops;
+    }
+    std::uint64_t value;
+    while(!stop.load(std::memory_order_relaxed))
+    {
+      if(tryPop(*queue, value))
+      {
+        ++ops;
+      }
+      else
+      {
+        std::this_thread::yield();
+      }
+    }
+    return ops;
+  });
+}
+}
+
+int main(int argc, char** argv)
+{
+  auto options = Benchmark::parseOptions(argc, argv);
+  Benchmark::printHeader("push/pop pairs", {"BoundedMPMC", "MSQueue", "Segmented", "ThreadSafe"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    Benchmark::printRow(threadNum, {
+      pairs<BoundedMPMCQueue<std::uint64_t>>(threadNum, options.mDuration),
+      pairs<MSQueue<std::uint64_t>>(threadNum, options.mDuration),
+      pairs<SegmentedQueue<std::uint64_t>>(threadNum, options.mDuration),
+      pairs<ThreadSafeQueue<std::uint64_t>>(threadNum, options.mDuration)});
+  }
+  Benchmark::printHeader("producers / consumers, popped elements", {"BoundedMPMC", "MSQueue", "Segmented", "ThreadSafe"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    if(threadNum < 2)
+    {
+      continue;
+    }
+    Benchmark::printRow(threadNum, {
+      producerConsumer<BoundedMPMCQueue<std::uint64_t>>(threadNum, options.mDuration),
+      producerConsumer<MSQueue<std::uint64_t>>(threadNum, options.mDuration),
+      producerConsumer<SegmentedQueue<std::uint64_t>>(threadNum, options.mDuration),
+      producerConsumer<ThreadSafeQueue<std::uint64_t>>(threadNum, options.mDuration)});
+  }
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include "Benchmark.hpp"
+#include "HazardPointer.hpp"
+#include "EpochBasedReclamation.hpp"
+#include "IntervalBasedReclamation.hpp"
+#include "LockFreeHashMap.hpp"
+#include "MSQueue.hpp"
+#include "LockFreeStack.hpp"
+
+namespace
+{
+constexpr int sKeyRange = 1 << 16;
+
+// 90% find, 5% insert, 5% remove on a map which holds about half of the key range
+template <typename Reclaimer>
+double readHeavyHashMap(std::size_t threadNum, std::chrono::milliseconds duration)
+{
+  LockFreeHashMap<int, int, std::hash<int>, 1 << 10, Reclaimer> map;
+  for(int i = 0; i < sKeyRange; i += 2)
+  {
+    map.insert({i, i});
+  }
+  return Benchmark::run(threadNum, duration, [&map](std::size_t id, const std::atomic<bool>& stop) {
+    Benchmark::Random rnd(id);
+    std::uint64_t ops = 0;
+    while(!stop.load(std::memory_order_relaxed))
+    {
+      auto r = rnd();
+      auto key = static_cast<int>(r % sKeyRange);
+      auto op = (r >> 32) % 100;
+      if(op < 90)
+      {
+        map.find(key);
+      }
+      else if(op < 95)
+      {
+        map.insert({key, key});
+      }
+      else
+      {
+        map.remove(key);
+      }
+      ++ops;
+    }
+    return ops;
+  });
+}
+
+template <typename Reclaimer>
+double pushPopQueue(std::size_t threadNum, std::chrono::milliseconds duration)
+{
+  MSQueue<int, Reclaimer> queue;
+  return Benchmark::run(threadNum, duration, [&queue](std::size_t id, const std::atomic<bool>& stop) {
+    std::uint64_t ops = 0;
+    while(!stop.load(std::memory_order_relaxed))
+    {
+      queue.push(static_cast<int>(id));
+      queue.tryPop();
+      ops += 2;
+    }
+    return ops;
+  });
+}
+
+template <typename Reclaimer>
+double pushPopStack(std::size_t threadNum, std::chrono::milliseconds duration)
+{
+  LockFreeStack<int, Reclaimer> stack;
+  return Benchmark::run(threadNum, duration, [&stack](std::size_t id, const std::atomic<bool>& stop) {
+    std::uint64_t ops = 0;
+    while(!stop.load(std::memory_order_relaxed))
+    {
+      stack.push(static_cast<int>(id));
+      stack.pop();
+      ops += 2;
+    }
+    return ops;
+  });
+}
+}
+
+int main(int argc, char** argv)
+{
+  auto options = Benchmark::parseOptions(argc, argv);
+  Benchmark::printHeader("LockFreeHashMap 90% find / 5% insert / 5% remove", {"HazardPointer", "Epoch", "Interval"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    Benchmark::printRow(threadNum, {
+      readHeavyHashMap<HazardPointerDomain<3>>(threadNum, options.mDuration),
+      readHeavyHashMap<EpochDomain>(threadNum, options.mDuration),
+      readHeavyHashMap<IntervalDomain>(threadNum, options.mDuration)});
+  }
+  Benchmark::printHeader("MSQueue push / tryPop", {"HazardPointer", "Epoch"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    Benchmark::printRow(threadNum, {
+      pushPopQueue<HazardPointerDomain<2>>(threadNum, options.mDuration),
+      pushPopQueue<EpochDomain>(threadNum, options.mDuration)});
+  }
+  Benchmark::printHeader("LockFreeStack push / pop", {"HazardPointer", "Epoch"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    Benchmark::printRow(threadNum, {
+      pushPopStack<HazardPointerDomain<>>(threadNum, options.mDuration),
+      pushPopStack<EpochDomain>(threadNum, options.mDuration)});
+  }
+  return 0;
+}
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include "Benchmark.hpp"
+#include "LockFreeSkipList.hpp"
+
+namespace
+{
+constexpr std::int64_t sKeyRange = 1 << 16;
+constexpr int sScanLength = 32;
+
+// the baseline, std::map under a single lock with the same interface as LockFreeSkipList
+class MutexMap
+{
+private:
+  std::map<std::int64_t, std::int64_t> mMap;
+  std::mutex mMutex;
+public:
+  bool insert(std::int64_t key, std::int64_t value)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMap.emplace(key, value).second;
+  }
+  bool remove(std::int64_t key)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMap.erase(key) == 1;
+  }
+  std::optional<std::int64_t> find(std::int64_t key)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mMap.find(key);
+    return it != mMap.end() ? std::optional<std::int64_t>(it->second) : std::nullopt;
+  }
+  std::int64_t scan(std::int64_t key, int length)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::int64_t sum = 0;
+    for(auto it = mMap.lower_bound(key); it != mMap.end() && 0 < length; ++it, --length)
+    {
+      sum += it->second;
+    }
+    return sum;
+  }
+};
+
+template <typename Key, typename Value>
+std::int64_t scan(LockFreeSkipList<Key, Value>& map, std::int64_t key, int length)
+{
+  std::int64_t sum = 0;
+  for(auto it = map.lower_bound(key); it != map.end() && 0 < length; ++it, --length)
+  {
+    sum += it->second;
+  }
+  return sum;
+}
+
+std::int64_t scan(MutexMap& map, std::int64_t key, int length)
+{
+  return map.scan(key, length);
+}
+
+// scanPercent% range scans of sScanLength elements or finds, and 5% inserts and 5% removes, on a map which holds about half of the key range
+template <typename Map>
+double mixed(std::size_t threadNum, std::chrono::milliseconds duration, int scanPercent)
+{
+  Map map;
+  for(std::int64_t i = 0; i < sKeyRange; i += 2)
+  {
+    map.insert(i, i);
+  }
+  return Benchmark::run(threadNum, duration, [&map, scanPercent](std::size_t id, const std::atomic<bool>& stop) {
+    Benchmark::Random rnd(id);
+    std::uint64_t ops = 0;
+    std::int64_t sum = 0;
+    while(!stop.load(std::memory_order_relaxed))
+    {
+      auto r = rnd();
+      auto key = static_cast<std::int64_t>(r % sKeyRange);
+      auto op = static_cast<int>((r >> 32) % 100);
+      if(op < scanPercent)
+      {
+        sum += scan(map, key, sScanLength);
+      }
+      else if(op < 90)
+      {
+        sum += map.find(key).value_or(0);
+      }
+      else if(op < 95)
+      {
+        map.insert(key, key);
+      }
+      else
+      {
+        map.remove(key);
+      }
+      ++ops;
+    }
+    // keeps the reads from being optimized away
+    return ops + (sum == -1);
+  });
+}
+}
+
+int main(int argc, char** argv)
+{
+  auto options = Benchmark::parseOptions(argc, argv);
+  Benchmark::printHeader("90% find / 5% insert / 5% remove", {"SkipList", "MutexMap"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    Benchmark::printRow(threadNum, {
+      mixed<LockFreeSkipList<std::int64_t, std::int64_t>>(threadNum, options.mDuration, 0),
+      mixed<MutexMap>(threadNum, options.mDuration, 0)});
+  }
+  Benchmark::printHeader("90% scan of 32 / 5% insert / 5% remove", {"SkipList", "MutexMap"});
+  for(auto threadNum: options.mThreadNums)
+  {
+    Benchmark::printRow(threadNum, {
+      mixed<LockFreeSkipList<std::int64_t, std::int64_t>>(threadNum, options.mDuration, 90),
+      mixed<MutexMap>(threadNum, options.mDuration, 90)});
+  }
+  return 0;
+}
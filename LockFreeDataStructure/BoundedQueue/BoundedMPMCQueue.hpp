@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// Bounded multi producer multi consumer queue on a ring of cells (D. Vyukov, Bounded MPMC queue).
+// Every cell has a sequence number which tells whether it is free for the push of a lap or full for the pop of the lap,
+// so a push or a pop is a single CAS on its own index and values are stored inline without any allocation or reclamation.
+// The two indices are on their own cache lines so that producers and consumers do not invalidate each other's line.
+// The capacity is rounded up to a power of 2. The queue is not lock-free in the strict sense:
+// a producer or a consumer preempted between its CAS and the store of the sequence number blocks the cell for the next lap.
+template <typename T>
+class BoundedMPMCQueue
+{
+  // an element is moved in and out of a reserved cell, which can not be given back if the move throws
+  static_assert(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>);
+private:
+  struct Cell
+  {
+    std::atomic<std::size_t> mSequence;
+    alignas(T) unsigned char mStorage[sizeof(T)];
+    T* get() noexcept { return std::launder(reinterpret_cast<T*>(mStorage)); }
+  };
+  static constexpr std::size_t sCacheLineSize = 64;
+  // blocking operations spin this many times before they yield the processor
+  static constexpr int sSpinCount = 64;
+  std::size_t mMask;
+  std::unique_ptr<Cell[]> mCells;
+  alignas(sCacheLineSize) std::atomic<std::size_t> mEnqueuePos;
+  alignas(sCacheLineSize) std::atomic<std::size_t> mDequeuePos;
+  static std::size_t roundUp(std::size_t capacity) noexcept
+  {
+    std::size_t n = 2;
+    while(n < capacity)
+    {
+      n *= 2;
+    }
+    return n;
+  }
+  static void backoff(int& spin) noexcept
+  {
+    if(++spin < sSpinCount)
+    {
+      return;
+    }
+    spin = 0;
+    std::this_thread::yield();
+  }
+  template <typename... Args>
+  bool tryEmplaceImpl(Args&&... args) noexcept;
+  // reserves the head cell and calls consume(T&) with its element
+  template <typename F>
+  bool popImpl(F&& consume);
+public:
+  explicit BoundedMPMCQueue(std::size_t capacity);
+  ~BoundedMPMCQueue();
+  BoundedMPMCQueue(const BoundedMPMCQueue&) = delete;
+  BoundedMPMCQueue& operator=(const BoundedMPMCQueue&) = delete;
+  // constructs an element at the tail, returns false without constructing it if the queue is full
+  template <typename... Args>
+  bool tryEmplace(Args&&... args)
+  {
+    if constexpr(std::is_nothrow_constructible_v<T, Args&&...>)
+    {
+      return tryEmplaceImpl(std::forward<Args>(args)...);
+    }
+    else
+    {
+      // the element is constructed before a cell is reserved, so that a throwing constructor leaves the queue as it was
+      return tryEmplaceImpl(T(std::forward<Args>(args)...));
+    }
+  }
+  bool tryPush(const T& value) { return tryEmplace(value); }
+  bool tryPush(T&& value) { return tryEmplace(std::move(value)); }
+  // moves the head to value, returns false if the queue is empty
+  bool tryPop(T& value);
+  std::optional<T> tryPop();
+  // wait while the queue is full or empty
+  void push(const T& value);
+  void push(T&& value);
+  void waitAndPop(T& value);
+  std::size_t capacity() const noexcept { return mMask + 1; }
+  // approximate while other threads use the queue
+  bool empty() const noexcept
+  {
+    return mDequeuePos.load(std::memory_order_relaxed) >= mEnqueuePos.load(std::memory_order_relaxed);
+  }
+};
+
+template <typename T>
+BoundedMPMCQueue<T>::BoundedMPMCQueue(std::size_t capacity)
+  : mMask(roundUp(capacity) - 1)
+  , mCells(new Cell[mMask + 1])
+  , mEnqueuePos(0)
+  , mDequeuePos(0)
+{
+  for(std::size_t i = 0; i <= mMask; ++i)
+  {
+    mCells[i].mSequence.store(i, std::memory_order_relaxed);
+  }
+}
+template <typename T>
+BoundedMPMCQueue<T>::~BoundedMPMCQueue()
+{
+  auto pos = mDequeuePos.load(std::memory_order_relaxed);
+  auto end = mEnqueuePos.load(std::memory_order_relaxed);
+  for(; pos != end; ++pos)
+  {
+    mCells[pos & mMask].get()->~T();
+  }
+}
+template <typename T>
+template <typename... Args>
+bool BoundedMPMCQueue<T>::tryEmplaceImpl(Args&&... args) noexcept
+{
+  auto pos = mEnqueuePos.load(std::memory_order_relaxed);
+  Cell* cell;
+  while(true)
+  {
+    cell = &mCells[pos & mMask];
+    // acquire pairs with the release of the pop which freed the cell in the previous lap
+    auto seq = cell->mSequence.load(std::memory_order_acquire);
+    auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+    if(diff == 0)
+    {
+      if(mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if(diff < 0)
+    {
+      // the cell still holds the element of the previous lap
+      return false;
+    }
+    else
+    {
+      pos = mEnqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+  new(cell->mStorage) T(std::forward<Args>(args)...);
+  cell->mSequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+template <typename T>
+template <typename F>
+bool BoundedMPMCQueue<T>::popImpl(F&& consume)
+{
+  auto pos = mDequeuePos.load(std::memory_order_relaxed);
+  Cell* cell;
+  while(true)
+  {
+    cell = &mCells[pos & mMask];
+    // acquire pairs with the release of the push which filled the cell
+    auto seq = cell->mSequence.load(std::memory_order_acquire);
+    auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+    if(diff == 0)
+    {
+      if(mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if(diff < 0)
+    {
+      return false;
+    }
+    else
+    {
+      pos = mDequeuePos.load(std::memory_order_relaxed);
+    }
+  }
+  auto elem = cell->get();
+  consume(*elem);
+  elem->~T();
+  // the cell is free for the push of the next lap
+  cell->mSequence.store(pos + mMask + 1, std::memory_order_release);
+  return true;
+}
+template <typename T>
+bool BoundedMPMCQueue<T>::tryPop(T& value)
+{
+  return popImpl([&value](T& elem) { value = std::move(elem); });
+}
+template <typename T>
+std::optional<T> BoundedMPMCQueue<T>::tryPop()
+{
+  std::optional<T> value;
+  popImpl([&value](T& elem) { value.emplace(std::move(elem)); });
+  return value;
+}
+template <typename T>
+void BoundedMPMCQueue<T>::push(const T& value)
+{
+  for(int spin = 0; !tryEmplace(value); backoff(spin));
+}
+template <typename T>
+void BoundedMPMCQueue<T>::push(T&& value)
+{
+  // tryEmplace moves from value only when it succeeds
+  for(int spin = 0; !tryEmplace(std::move(value)); backoff(spin));
+}
+template <typename T>
+void BoundedMPMCQueue<T>::waitAndPop(T& value)
+{
+  for(int spin = 0; !tryPop(value); backoff(spin));
+}
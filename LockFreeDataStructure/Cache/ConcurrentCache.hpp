@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "LockFreeHashMap.hpp"
+
+// every entry weighs 1, so the capacity of a cache is the number of entries
+struct UnitWeigher
+{
+  template <typename Key, typename Value>
+  std::size_t operator()(const Key&, const Value&) const noexcept { return 1; }
+};
+
+// Bounded cache on LockFreeHashMap with CLOCK eviction. The capacity is the total weight of the entries given by Weigher(key, value),
+// e.g. the number of entries with UnitWeigher or bytes with a weigher which returns the size of the value.
+// A hit only sets the reference bit of its entry, so lookups never write any state shared with other keys.
+// The clock hand sweeps the map one partition of for_each at a time, the split order of the map is a fixed circular order of the keys.
+// A referenced entry gets its bit cleared and a second chance, the other entries of the partition are evicted as a batch.
+// A thread which finds the cache over capacity after put evicts down to a low watermark, so that the cost of a sweep is shared by many puts.
+// Several threads sweep different partitions at the same time.
+// The capacity may be exceeded for a moment while entries are being inserted.
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename Weigher = UnitWeigher, typename Reclaimer = HazardPointerDomain<3>>
+class ConcurrentCache
+{
+private:
+  struct Entry
+  {
+    Value mValue;
+    std::size_t mWeight;
+    mutable std::atomic<bool> mReferenced;
+    // a new entry is referenced so that the eviction run by its own put does not take it first
+    Entry(const Value& value, std::size_t weight): mValue(value), mWeight(weight), mReferenced(true) {}
+  };
+  using EntryPtr = std::shared_ptr<const Entry>;
+  // the partitions swept at a time have about this many entries
+  static constexpr std::size_t sBatchSize = 64;
+  LockFreeHashMap<Key, EntryPtr, Hash, 1 << 10, Reclaimer> mMap;
+  std::atomic<std::int64_t> mWeight;
+  std::atomic<std::uint64_t> mHand; // the position of the clock hand, the partition of a sweep is its top bits
+  std::size_t mCapacity;
+  std::size_t mLowWatermark; // eviction stops at this weight, 1/32 of the capacity below it
+  Weigher mWeigher; // TODO: EBO
+  void evict();
+public:
+  explicit ConcurrentCache(std::size_t capacity, const Weigher& weigher = Weigher(), Reclaimer& reclaimer = Reclaimer::defaultDomain());
+  ConcurrentCache(const ConcurrentCache&) = delete;
+  ConcurrentCache& operator=(const ConcurrentCache&) = delete;
+  std::optional<Value> get(const Key& key);
+  // inserts or replaces the entry of key, then evicts entries if the cache is over capacity
+  void put(const Key& key, const Value& value);
+  bool remove(const Key& key);
+  std::size_t capacity() const noexcept { return mCapacity; }
+  // the total weight of the entries, approximate while other threads update the cache
+  std::size_t weight() const noexcept { return static_cast<std::size_t>(std::max<std::int64_t>(mWeight.load(std::memory_order_relaxed), 0)); }
+  std::size_t size() const noexcept { return mMap.size(); }
+};
+
+template <typename Key, typename Value, typename Hash, typename Weigher, typename Reclaimer>
+ConcurrentCache<Key, Value, Hash, Weigher, Reclaimer>::ConcurrentCache(std::size_t capacity, const Weigher& weigher, Reclaimer& reclaimer)
+  : mMap(reclaimer)
+  , mWeight(0)
+  , mHand(0)
+  , mCapacity(capacity)
+  , mLowWatermark(capacity - capacity / 32)
+  , mWeigher(weigher)
+{
+}
+template <typename Key, typename Value, typename Hash, typename Weigher, typename Reclaimer>
+void ConcurrentCache<Key, Value, Hash, Weigher, Reclaimer>::evict()
+{
+  auto overCapacity = [this]() { return static_cast<std::int64_t>(mLowWatermark) < mWeight.load(std::memory_order_relaxed); };
+  std::vector<std::pair<Key, EntryPtr>> victims;
+  // two rounds of the clock at most, the first one may only clear the reference bits
+  for(std::size_t step = 0, stepNum = 1; step < 2 * stepNum + 1 && overCapacity(); ++step)
+  {
+    std::size_t partitionNum = 1;
+    unsigned int shift = 64;
+    while(partitionNum * sBatchSize * 2 <= mMap.size())
+    {
+      partitionNum *= 2;
+      --shift;
+    }
+    stepNum = partitionNum;
+    auto position = mHand.fetch_add(shift == 64 ? 0 : static_cast<std::uint64_t>(1) << shift, std::memory_order_relaxed);
+    auto partition = shift == 64 ? 0 : static_cast<std::size_t>(position >> shift);
+    victims.clear();
+    mMap.for_each(partition, partitionNum, [&victims](const Key& key, const EntryPtr& entry) {
+      if(entry->mReferenced.load(std::memory_order_relaxed))
+      {
+        entry->mReferenced.store(false, std::memory_order_relaxed);
+      }
+      else
+      {
+        victims.emplace_back(key, entry);
+      }
+    });
+    for(auto& [key, entry]: victims)
+    {
+      if(!overCapacity())
+      {
+        break;
+      }
+      // the entry may have been replaced or referenced since the sweep visited it
+      auto stillCold = [&entry = entry](const EntryPtr& current) {
+        return current == entry && !current->mReferenced.load(std::memory_order_relaxed);
+      };
+      if(mMap.erase_if(key, stillCold))
+      {
+        mWeight.fetch_sub(static_cast<std::int64_t>(entry->mWeight), std::memory_order_relaxed);
+      }
+    }
+  }
+}
+template <typename Key, typename Value, typename Hash, typename Weigher, typename Reclaimer>
+std::optional<Value> ConcurrentCache<Key, Value, Hash, Weigher, Reclaimer>::get(const Key& key)
+{
+  std::optional<Value> ans;
+  // visit does not copy the shared_ptr, so hits on a hot entry do not contend on its reference count
+  mMap.visit(key, [&ans](const EntryPtr& entry) {
+    // the bit is written only when it changes so that hot entries stay shared in the caches of the readers
+    auto& referenced = entry->mReferenced;
+    if(!referenced.load(std::memory_order_relaxed))
+    {
+      referenced.store(true, std::memory_order_relaxed);
+    }
+    ans = entry->mValue;
+  });
+  return ans;
+}
+template <typename Key, typename Value, typename Hash, typename Weigher, typename Reclaimer>
+void ConcurrentCache<Key, Value, Hash, Weigher, Reclaimer>::put(const Key& key, const Value& value)
+{
+  auto weight = mWeigher(key, value);
+  auto entry = std::make_shared<const Entry>(value, weight);
+  std::size_t oldWeight = 0;
+  // fn is called again if the CAS fails, the last call sees the replaced entry
+  mMap.compute(key, [&oldWeight, &entry](const EntryPtr* current) {
+    oldWeight = current ? (*current)->mWeight : 0;
+    return std::optional<EntryPtr>(entry);
+  });
+  auto total = mWeight.fetch_add(static_cast<std::int64_t>(weight) - static_cast<std::int64_t>(oldWeight), std::memory_order_relaxed)
+             + static_cast<std::int64_t>(weight) - static_cast<std::int64_t>(oldWeight);
+  if(static_cast<std::int64_t>(mCapacity) < total)
+  {
+    evict();
+  }
+}
+template <typename Key, typename Value, typename Hash, typename Weigher, typename Reclaimer>
+bool ConcurrentCache<Key, Value, Hash, Weigher, Reclaimer>::remove(const Key& key)
+{
+  std::size_t weight = 0;
+  if(!mMap.erase_if(key, [&weight](const EntryPtr& current) { weight = current->mWeight; return true; }))
+  {
+    return false;
+  }
+  mWeight.fetch_sub(static_cast<std::int64_t>(weight), std::memory_order_relaxed);
+  return true;
+}
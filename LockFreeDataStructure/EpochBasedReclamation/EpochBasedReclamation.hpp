@@ -0,0 +1,364 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include "HazardPointer.hpp"
+
+namespace Detail
+{
+struct EpochRecord
+{
+  std::atomic<std::uint64_t> mEpoch; // (epoch << 1) | 1 while the owner thread is in a critical section, 0 otherwise.
+  std::atomic<bool> mInUse;
+  EpochRecord* mNext;
+  EpochRecord() noexcept: mEpoch(0), mInUse(true), mNext(nullptr) {}
+};
+class EpochRecordList
+{
+private:
+  std::atomic<EpochRecord*> mHead;
+public:
+  constexpr EpochRecordList() noexcept: mHead(nullptr) {}
+  ~EpochRecordList()
+  {
+    auto cur = mHead.load(std::memory_order_acquire);
+    while(cur)
+    {
+      auto next = cur->mNext;
+      delete cur;
+      cur = next;
+    }
+  }
+  EpochRecord* acquire()
+  {
+    // records of exited threads are reused so that the list does not grow with the number of threads ever created.
+    for(auto cur = mHead.load(std::memory_order_acquire); cur; cur = cur->mNext)
+    {
+      bool expected = false;
+      if(!cur->mInUse.load(std::memory_order_relaxed) &&
+         cur->mInUse.compare_exchange_strong(expected, true, std::memory_order_acquire, std::memory_order_relaxed))
+      {
+        return cur;
+      }
+    }
+    auto node = new EpochRecord();
+    node->mNext = mHead.load(std::memory_order_relaxed);
+    while(!mHead.compare_exchange_weak(node->mNext, node, std::memory_order_release, std::memory_order_relaxed));
+    return node;
+  }
+  EpochRecord* getHead() const noexcept
+  {
+    return mHead.load(std::memory_order_acquire);
+  }
+};
+struct LimboBag
+{
+  DeleteListNode* mHead;
+  std::uint64_t mEpoch;
+  LimboBag* mNext;
+  LimboBag(DeleteListNode* head, std::uint64_t epoch) noexcept: mHead(head), mEpoch(epoch), mNext(nullptr) {}
+  ~LimboBag()
+  {
+    auto cur = mHead;
+    while(cur)
+    {
+      auto next = cur->mNext;
+      delete cur;
+      cur = next;
+    }
+  }
+};
+class OrphanBagList
+{
+private:
+  std::atomic<LimboBag*> mHead;
+public:
+  constexpr OrphanBagList() noexcept: mHead(nullptr) {}
+  ~OrphanBagList()
+  {
+    auto cur = resetHead();
+    while(cur)
+    {
+      auto next = cur->mNext;
+      delete cur;
+      cur = next;
+    }
+  }
+  void append(LimboBag* bag) noexcept
+  {
+    bag->mNext = mHead.load(std::memory_order_relaxed);
+    while(!mHead.compare_exchange_weak(bag->mNext, bag, std::memory_order_release, std::memory_order_relaxed));
+  }
+  LimboBag* resetHead() noexcept
+  {
+    return mHead.exchange(nullptr, std::memory_order_acquire);
+  }
+  LimboBag* loadHead(std::memory_order order) const noexcept
+  {
+    return mHead.load(order);
+  }
+};
+}
+
+class EpochGuard;
+
+// Epoch based reclamation (Fraser).
+// Readers announce the global epoch once per operation instead of publishing every node they visit,
+// a node retired in epoch e is freed after the global epoch reaches e + 2.
+// A thread which stalls inside a critical section blocks all reclamation, so memory is not bounded as with hazard pointers.
+// All the state is process wide, defaultDomain() only exists to have the same interface as HazardPointerDomain.
+class EpochDomain
+{
+private:
+  static constexpr std::size_t sBagNum = 3;
+  static constexpr int sReclaimThreshold = 128;
+  class ThreadState
+  {
+  public:
+    Detail::EpochRecord* mRecord;
+    std::array<Detail::DeleteListNode*, sBagNum> mBags;
+    std::array<std::uint64_t, sBagNum> mBagEpochs;
+    std::array<int, sBagNum> mBagSizes;
+    ThreadState(): mRecord(sEpochRecordList.acquire()), mBags{}, mBagEpochs{}, mBagSizes{}
+    {
+      sRecord = mRecord;
+    }
+    ~ThreadState()
+    {
+      // nodes may be still used by other threads, so they are moved to the orphan list instead of being deleted.
+      for(std::size_t i = 0; i < sBagNum; ++i)
+      {
+        if(mBags[i])
+        {
+          sOrphanBagList.append(new Detail::LimboBag(mBags[i], mBagEpochs[i]));
+        }
+      }
+      sRecord = nullptr;
+      mRecord->mEpoch.store(0, std::memory_order_release);
+      mRecord->mInUse.store(false, std::memory_order_release);
+    }
+    int size() const noexcept
+    {
+      int ans = 0;
+      for(auto sz: mBagSizes)
+      {
+        ans += sz;
+      }
+      return ans;
+    }
+    void freeBag(std::size_t i) noexcept
+    {
+      Detail::LimboBag bag(mBags[i], mBagEpochs[i]);
+      mBags[i] = nullptr;
+      mBagSizes[i] = 0;
+    }
+  };
+  inline static std::atomic<std::uint64_t> sGlobalEpoch{0};
+  inline static Detail::EpochRecordList sEpochRecordList;
+  inline static Detail::OrphanBagList sOrphanBagList;
+  inline static thread_local ThreadState sThreadState;
+  // trivially constructible copies of the hot fields of sThreadState, which avoid the initialization check of sThreadState on every access.
+  inline static thread_local Detail::EpochRecord* sRecord = nullptr;
+  inline static thread_local unsigned int sNestCount = 0;
+  EpochDomain() = default;
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain(EpochDomain&&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+  EpochDomain& operator=(EpochDomain&&) = delete;
+  ~EpochDomain() = default;
+  static std::uint64_t tryAdvance() noexcept
+  {
+    auto epoch = sGlobalEpoch.load(std::memory_order_acquire);
+    // pairs with the fence in enterCriticalSection
+    Detail::seqCstFence();
+    for(auto cur = sEpochRecordList.getHead(); cur; cur = cur->mNext)
+    {
+      // acquire pairs with the release stores of the owner thread so that its reads in the previous critical sections happen before the reclamation.
+      auto e = cur->mEpoch.load(std::memory_order_acquire);
+      if((e & 1) && (e >> 1) != epoch)
+      {
+        return epoch;
+      }
+    }
+    if(sGlobalEpoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+    {
+      return epoch + 1;
+    }
+    return epoch;
+  }
+  // returns the index of the bag for the current epoch, nodes have to be unlinked before this is called.
+  static std::size_t getCurrentBag(ThreadState& state) noexcept
+  {
+    // the fence orders the load of the epoch after the unlink of data, see also tryAdvance
+    Detail::seqCstFence();
+    auto epoch = sGlobalEpoch.load(std::memory_order_acquire);
+    auto i = epoch % sBagNum;
+    if(state.mBags[i] && state.mBagEpochs[i] != epoch)
+    {
+      // the bag was filled at epoch - 3 or before
+      state.freeBag(i);
+    }
+    state.mBagEpochs[i] = epoch;
+    return i;
+  }
+public:
+  using Holder = EpochGuard;
+  // nodes do not need any per node state for this domain, see also IntervalDomain::NodeBase.
+  struct NodeBase {};
+  static EpochDomain& defaultDomain() noexcept
+  {
+    static EpochDomain sDomain;
+    return sDomain;
+  }
+  static void enterCriticalSection()
+  {
+    if(sNestCount++ == 0)
+    {
+      auto record = sRecord ? sRecord : sThreadState.mRecord;
+      auto epoch = sGlobalEpoch.load(std::memory_order_relaxed);
+      record->mEpoch.store((epoch << 1) | 1, std::memory_order_release);
+      Detail::seqCstFence();
+    }
+  }
+  static void leaveCriticalSection() noexcept
+  {
+    if(--sNestCount == 0)
+    {
+      sRecord->mEpoch.store(0, std::memory_order_release);
+    }
+  }
+  static Holder makeHolder(std::size_t i = 0);
+  template <typename Deleter>
+  static void retire(void* data, Deleter&& deleter)
+  {
+    auto node = std::make_unique<Detail::DeleteListNode>(data, std::forward<Deleter>(deleter));
+    auto& state = sThreadState;
+    auto i = getCurrentBag(state);
+    node->mNext = state.mBags[i];
+    state.mBags[i] = node.release();
+    state.mBagSizes[i]++;
+    if(sReclaimThreshold < state.size())
+    {
+      tryReclaim();
+    }
+  }
+  // retires the nodes pointed by the iterators in [first, last) into the same bag, reclamation is tried at most once for the whole range.
+  // None of the nodes is retired if an allocation throws.
+  template <typename InputIterator, typename Deleter>
+  static void retireBatch(InputIterator first, InputIterator last, Deleter&& deleter)
+  {
+    if(first == last)
+    {
+      return;
+    }
+    std::function<void(void*)> f(std::forward<Deleter>(deleter));
+    auto& state = sThreadState;
+    auto chain = Detail::makeDeleteListChain(first, last, f);
+    auto i = getCurrentBag(state);
+    chain.mTail->mNext = state.mBags[i];
+    state.mBags[i] = chain.mHead;
+    state.mBagSizes[i] += chain.mSize;
+    if(sReclaimThreshold < state.size())
+    {
+      tryReclaim();
+    }
+  }
+  static void tryReclaim()
+  {
+    auto& state = sThreadState;
+    auto epoch = tryAdvance();
+    for(std::size_t i = 0; i < sBagNum; ++i)
+    {
+      if(state.mBags[i] && state.mBagEpochs[i] + 2 <= epoch)
+      {
+        state.freeBag(i);
+      }
+    }
+    // we do not have to collect bags of exited threads right away.
+    if(sOrphanBagList.loadHead(std::memory_order_relaxed))
+    {
+      auto cur = sOrphanBagList.resetHead();
+      while(cur)
+      {
+        auto next = cur->mNext;
+        if(cur->mEpoch + 2 <= epoch)
+        {
+          delete cur;
+        }
+        else
+        {
+          sOrphanBagList.append(cur);
+        }
+        cur = next;
+      }
+    }
+  }
+};
+
+class EpochGuard
+{
+private:
+  bool mActive;
+public:
+  EpochGuard(): mActive(true)
+  {
+    EpochDomain::enterCriticalSection();
+  }
+  ~EpochGuard()
+  {
+    if(mActive)
+    {
+      EpochDomain::leaveCriticalSection();
+    }
+  }
+  EpochGuard(const EpochGuard&) = delete;
+  EpochGuard(EpochGuard&& other) noexcept: mActive(other.mActive)
+  {
+    other.mActive = false;
+  }
+  EpochGuard& operator=(const EpochGuard&) = delete;
+  EpochGuard& operator=(EpochGuard&& other) noexcept
+  {
+    EpochGuard tmp(std::move(other));
+    swap(tmp);
+    return *this;
+  }
+  // nodes are protected by the critical section as a whole, so there is nothing to publish per pointer.
+  void store(void*) noexcept {}
+  void release() noexcept {}
+  void swap(EpochGuard& other) noexcept
+  {
+    using std::swap;
+    swap(mActive, other.mActive);
+  }
+};
+
+inline void swap(EpochGuard& x, EpochGuard& y) noexcept
+{
+  x.swap(y);
+}
+
+inline EpochGuard EpochDomain::makeHolder(std::size_t)
+{
+  return EpochGuard();
+}
+
+template <typename T>
+T* claimPointer(std::atomic<T*>& pointer, EpochGuard&)
+{
+  return pointer.load(std::memory_order_acquire);
+}
+
+template <typename MarkablePointer>
+auto claimMarkablePointer(MarkablePointer& markablePointer, EpochGuard&, bool* mark = nullptr)
+{
+  auto [p, m] = markablePointer.load(std::memory_order_acquire);
+  if(mark)
+  {
+    *mark = m;
+  }
+  return p;
+}
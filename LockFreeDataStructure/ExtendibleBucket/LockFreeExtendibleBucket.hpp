@@ -0,0 +1,312 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <new>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+#include "AtomicStampedPointer.hpp"
+
+struct DefaultInitializer
+{
+  template <typename T>
+  void operator()(T&&) {}
+};
+// leaf allocators of LockFreeExtendibleBucket
+struct NewLeafAllocator
+{
+  static void* allocate(std::size_t size, std::size_t alignment)
+  {
+    return ::operator new(size, std::align_val_t(alignment));
+  }
+  static void deallocate(void* p, std::size_t, std::size_t alignment) noexcept
+  {
+    ::operator delete(p, std::align_val_t(alignment));
+  }
+};
+// places leaves in 2MB huge pages to cut TLB misses on large directories, a leaf should be a multiple of 2MB not to waste the rest of the page.
+// Reserved huge pages (MAP_HUGETLB) are used if any, otherwise transparent huge pages are requested by madvise on a 2MB aligned mapping.
+// Falls back to NewLeafAllocator on non linux platforms.
+struct HugePageLeafAllocator
+{
+  static constexpr std::size_t sHugePageSize = 2 << 20;
+  static constexpr std::size_t roundUp(std::size_t size) noexcept
+  {
+    return (size + sHugePageSize - 1) & ~(sHugePageSize - 1);
+  }
+  static void* allocate(std::size_t size, std::size_t alignment)
+  {
+#if defined(__linux__)
+    assert(alignment <= sHugePageSize);
+    size = roundUp(size);
+#if defined(MAP_HUGETLB)
+    auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(p != MAP_FAILED)
+    {
+      return p;
+    }
+#endif
+    // the mapping is trimmed to a 2MB boundary so that the kernel can back it with huge pages
+    auto mapped = mmap(nullptr, size + sHugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mapped == MAP_FAILED)
+    {
+      throw std::bad_alloc();
+    }
+    auto begin = reinterpret_cast<std::uintptr_t>(mapped);
+    auto aligned = (begin + sHugePageSize - 1) & ~static_cast<std::uintptr_t>(sHugePageSize - 1);
+    if(begin < aligned)
+    {
+      munmap(mapped, aligned - begin);
+    }
+    munmap(reinterpret_cast<void*>(aligned + size), begin + sHugePageSize - aligned);
+#if defined(MADV_HUGEPAGE)
+    madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+#endif
+    return reinterpret_cast<void*>(aligned);
+#else
+    return NewLeafAllocator::allocate(size, alignment);
+#endif
+  }
+  static void deallocate(void* p, std::size_t size, std::size_t alignment) noexcept
+  {
+#if defined(__linux__)
+    munmap(p, roundUp(size));
+#else
+    NewLeafAllocator::deallocate(p, size, alignment);
+#endif
+  }
+};
+// directory which grows by doubling its size without moving the elements. The elements are stored in leaves of BaseArraySize elements,
+// which are the leaves of a tree of inner nodes with sInnerSize children, the tree gets taller when the size exceeds its capacity.
+// Nodes are allocated on the first access, leaves by LeafAllocator.
+// Nodes have no header so that a leaf is exactly BaseArraySize elements, the height of the root is kept in the stamp of the root pointer.
+template <typename T, std::size_t BaseArraySize = 1 << 10, typename Initializer = DefaultInitializer, typename LeafAllocator = NewLeafAllocator>
+class LockFreeExtendibleBucket
+{
+  static constexpr bool isPowersOf2(std::size_t x)
+  {
+    if(x < 2)
+    {
+      return x == 1;
+    }
+    return x % 2 ? false : isPowersOf2(x / 2);
+  }
+  static constexpr std::size_t exponent(std::size_t x)
+  {
+    return x == 1 ? 0 : exponent(x / 2) + 1;
+  }
+  static_assert(isPowersOf2(BaseArraySize));
+private:
+  static constexpr unsigned int sLeafShift = exponent(BaseArraySize);
+  static constexpr unsigned int sInnerShift = 10;
+  static constexpr std::size_t sInnerSize = 1 << sInnerShift;
+  // the height of a leaf is 0, the walk from the root counts the height down
+  struct Node {};
+  struct LeafNode: Node
+  {
+    std::array<T, BaseArraySize> mData;
+    LeafNode(): mData()
+    {
+      for(auto& elem: mData)
+      {
+        Initializer()(elem);
+      }
+    }
+  };
+  struct InnerNode: Node
+  {
+    std::array<std::atomic<Node*>, sInnerSize> mChildren;
+    InnerNode()
+    {
+      for(auto& child: mChildren)
+      {
+        child.store(nullptr, std::memory_order_relaxed);
+      }
+    }
+  };
+  // the stamp holds the exponent of the size in the low byte and the height of the root in the high byte
+  using StampType = typename AtomicStampedPointer<Node>::StampType;
+  static constexpr unsigned int sHeightShift = 8;
+  static constexpr StampType makeStamp(unsigned int exp, unsigned int height) { return static_cast<StampType>(exp | height << sHeightShift); }
+  static constexpr unsigned int exponentOf(StampType stamp) { return stamp & ((1 << sHeightShift) - 1); }
+  static constexpr unsigned int heightOf(StampType stamp) { return stamp >> sHeightShift; }
+  AtomicStampedPointer<Node> mRoot;
+private:
+  // a child of a node of the height holds 1 << childShift(height) elements, a tree of the height holds 1 << childShift(height + 1) elements
+  static constexpr unsigned int childShift(unsigned int height)
+  {
+    return sLeafShift + sInnerShift * (height - 1);
+  }
+  static Node* createNode(unsigned int height)
+  {
+    if(height)
+    {
+      return new InnerNode();
+    }
+    auto p = LeafAllocator::allocate(sizeof(LeafNode), alignof(LeafNode));
+    try
+    {
+      return new(p) LeafNode();
+    }
+    catch(...)
+    {
+      LeafAllocator::deallocate(p, sizeof(LeafNode), alignof(LeafNode));
+      throw;
+    }
+  }
+  static void destroyTree(Node* node, unsigned int height)
+  {
+    if(!node)
+    {
+      return;
+    }
+    if(height == 0)
+    {
+      auto leaf = static_cast<LeafNode*>(node);
+      leaf->~LeafNode();
+      LeafAllocator::deallocate(leaf, sizeof(LeafNode), alignof(LeafNode));
+      return;
+    }
+    auto inner = static_cast<InnerNode*>(node);
+    for(auto& child: inner->mChildren)
+    {
+      destroyTree(child.exchange(nullptr, std::memory_order_acquire), height - 1);
+    }
+    delete inner;
+  }
+  T& getImpl(std::size_t i, Node* node, unsigned int height)
+  {
+    for(; height; --height)
+    {
+      auto& child = static_cast<InnerNode*>(node)->mChildren[(i >> childShift(height)) & (sInnerSize - 1)];
+      auto childNode = child.load(std::memory_order_acquire);
+      if(childNode == nullptr)
+      {
+        auto newChild = createNode(height - 1);
+        if(child.compare_exchange_strong(childNode, newChild, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+          childNode = newChild;
+        }
+        else
+        {
+          destroyTree(newChild, height - 1);
+        }
+      }
+      node = childNode;
+    }
+    return static_cast<LeafNode*>(node)->mData[i & (BaseArraySize - 1)];
+  }
+  template <typename F>
+  void releaseImpl(Node* node, unsigned int height, std::size_t offset, std::size_t begin, F& fn)
+  {
+    if(height == 0)
+    {
+      auto& data = static_cast<LeafNode*>(node)->mData;
+      for(auto i = std::min<std::size_t>(begin - std::min(begin, offset), BaseArraySize); i < BaseArraySize; ++i)
+      {
+        fn(data[i]);
+      }
+      return;
+    }
+    auto size = static_cast<std::size_t>(1) << childShift(height);
+    auto& children = static_cast<InnerNode*>(node)->mChildren;
+    for(std::size_t i = 0; i < sInnerSize; ++i)
+    {
+      auto childOffset = offset + i * size;
+      auto childNode = children[i].load(std::memory_order_acquire);
+      if(!childNode || childOffset + size <= begin)
+      {
+        continue;
+      }
+      releaseImpl(childNode, height - 1, childOffset, begin, fn);
+      if(begin <= childOffset)
+      {
+        children[i].store(nullptr, std::memory_order_relaxed);
+        destroyTree(childNode, height - 1);
+      }
+    }
+  }
+  bool extendTree(Node* root, StampType stamp)
+  {
+    auto height = heightOf(stamp);
+    auto newRoot = static_cast<InnerNode*>(createNode(height + 1));
+    newRoot->mChildren[0].store(root, std::memory_order_relaxed);
+    Node* expected = root;
+    bool success = mRoot.compare_exchange_strong(
+      expected, newRoot, stamp, makeStamp(exponentOf(stamp) + 1, height + 1), std::memory_order_release, std::memory_order_relaxed);
+    if(!success)
+    {
+      newRoot->mChildren[0].store(nullptr, std::memory_order_relaxed);
+      destroyTree(newRoot, height + 1);
+    }
+    return success;
+  }
+  static unsigned int getHeight(std::size_t size)
+  {
+    unsigned int height = 0;
+    while(childShift(height + 1) < exponent(size))
+    {
+      ++height;
+    }
+    return height;
+  }
+public:
+  // the bytes a leaf takes, a leaf allocator which rounds up to pages wastes nothing if this is a multiple of the page size
+  static constexpr std::size_t sLeafSize = sizeof(LeafNode);
+  LockFreeExtendibleBucket(std::size_t initialSize = BaseArraySize)
+    : mRoot(createNode(getHeight(initialSize)), makeStamp(exponent(initialSize), getHeight(initialSize)))
+  {
+    assert(isPowersOf2(initialSize));
+  }
+  ~LockFreeExtendibleBucket()
+  {
+    auto [root, stamp] = mRoot.exchange(nullptr, 0);
+    destroyTree(root, heightOf(stamp));
+  }
+  LockFreeExtendibleBucket(const LockFreeExtendibleBucket&) = delete;
+  LockFreeExtendibleBucket& operator=(const LockFreeExtendibleBucket&) = delete;
+  bool extend()
+  {
+    auto [root, stamp] = mRoot.load();
+    if(exponentOf(stamp) < childShift(heightOf(stamp) + 1))
+    {
+      // release sequences allow us to use relaxed ordering here
+      return mRoot.compare_exchange_strong(
+        root, root, stamp, stamp + 1, std::memory_order_relaxed, std::memory_order_relaxed);
+    }
+    return extendTree(root, stamp);
+  }
+  // halves the size, the elements beyond the new size are kept until releaseFrom frees them.
+  bool shrink()
+  {
+    auto [root, stamp] = mRoot.load();
+    if(exponentOf(stamp) == 0)
+    {
+      return false;
+    }
+    return mRoot.compare_exchange_strong(
+      root, root, stamp, stamp - 1, std::memory_order_relaxed, std::memory_order_relaxed);
+  }
+  // calls fn for each allocated element whose index is not less than begin, then frees the nodes which hold only such elements.
+  // Other threads must not access these elements during and after the call, until the size grows again.
+  template <typename F>
+  void releaseFrom(std::size_t begin, F&& fn)
+  {
+    auto [root, stamp] = mRoot.load(std::memory_order_acquire);
+    releaseImpl(root, heightOf(stamp), 0, begin, fn);
+  }
+  T& operator[](std::size_t i)
+  {
+    auto [root, stamp] = mRoot.load(std::memory_order_acquire);
+    return getImpl(i, root, heightOf(stamp));
+  }
+  std::size_t size() const noexcept
+  {
+    auto [root, stamp] = mRoot.load(std::memory_order_acquire);
+    return static_cast<std::size_t>(1) << exponentOf(stamp);
+  }
+};
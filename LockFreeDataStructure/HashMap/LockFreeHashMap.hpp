@@ -1,222 +1,97 @@
 #pragma once
 
+#include <array>
 #include <functional>
 #include <cassert>
 #include <memory>
 #include <optional>
-#include <variant>
 #include <cstdint>
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <iterator>
+#include <thread>
+#include <tuple>
+#include <vector>
 #include "AtomicMarkablePointer.hpp"
-#include "AtomicStampedPointer.hpp"
 #include "HazardPointer.hpp"
+#include "LockFreeExtendibleBucket.hpp"
+#include "NodePool.hpp"
+#include "ShardedCounter.hpp"
 
-struct DefaultInitializer
+// Reclaimer is HazardPointerDomain<3> or any other domain which has the same interface, e.g. EpochDomain or IntervalDomain.
+// Nodes derive from Reclaimer::NodeBase so that domains can keep per node state such as the birth era.
+// The list traversal needs three protected pointers at a time.
+// NodeAllocator is NewDeleteNodeAllocator by default or PoolNodeAllocator, which keeps its memory until the process exits, see NodePool.hpp.
+// The bucket directory has leaves of BaseArraySize buckets allocated by LeafAllocator, e.g. 1 << 18 with HugePageLeafAllocator fills a 2MB page.
+// ResizePolicy is GrowOnly or GrowAndShrink.
+
+// resize policies of LockFreeHashMap.
+// The bucket directory only grows by default. GrowAndShrink also halves it after removals,
+// which costs every operation a registration in a generation counter so that the sentinels of removed buckets are retired safely.
+struct GrowOnly
 {
-  template <typename T>
-  void operator()(T&&) {}
+  static constexpr bool sShrink = false;
 };
-template <typename T, std::size_t BaseArraySize = 1 << 10, typename Initializer = DefaultInitializer>
-class LockFreeExtendibleBucket
+struct GrowAndShrink
 {
-  static constexpr bool isPowersOf2(std::size_t x)
-  {
-    if(x < 2)
-    {
-      return x == 1;
-    }
-    return x % 2 ? false : isPowersOf2(x / 2);
-  }
-  static constexpr std::size_t exponent(std::size_t x)
-  {
-    return x == 1 ? 0 : exponent(x / 2) + 1;
-  }
-  static_assert(isPowersOf2(BaseArraySize));
-private:
-  struct BucketNode
-  {
-    static constexpr std::size_t sBucketSize = 1 << 10;
-    template <typename U>
-    using BucketArray = std::array<U, sBucketSize>;
-    using LeafNodeElement = T;
-    using InnerNodeElement = std::atomic<BucketNode*>;
-    using Data = std::variant<BucketArray<LeafNodeElement>, BucketArray<InnerNodeElement>>;
-    static constexpr std::size_t LeafNodeIndex = 0;
-    static constexpr std::size_t InnerNodeIndex = 1;
-    unsigned int mHeight;
-    Data mBucket;
-    explicit BucketNode(unsigned int height)
-      : mHeight(height)
-      , mBucket(mHeight == 0 ? Data(std::in_place_index<LeafNodeIndex>) : Data(std::in_place_index<InnerNodeIndex>))
-    {
-      if(mHeight)
-      {
-        auto& data = std::get<InnerNodeIndex>(mBucket);
-        for(auto& elem: data)
-        {
-          elem.store(nullptr, std::memory_order_relaxed);
-        }
-      }
-      else
-      {
-        auto& data = std::get<LeafNodeIndex>(mBucket);
-        for(auto& elem: data)
-        {
-          Initializer()(elem);
-        }
-      }
-    }
-  };
-  using ExponentType =typename AtomicStampedPointer<BucketNode>::StampType;
-  AtomicStampedPointer<BucketNode> mRoot;
-private:
-  static std::size_t pow(std::size_t x, std::size_t y)
-  {
-    std::size_t ans = 1;
-    for(std::size_t i = 0; i < y; ++i)
-    {
-      ans *= x;
-    }
-    return ans;
-  }
-  void cleanupTree(BucketNode* node)
-  {
-    if(!node)
-    {
-      return;
-    }
-    if(node->mHeight)
-    {
-      auto& bucket = std::get<BucketNode::InnerNodeIndex>(node->mBucket);
-      for(auto& node: bucket)
-      {
-        cleanupTree(node.exchange(nullptr, std::memory_order_acquire));
-      }
-    }
-    delete node;
-  }
-  T& getImpl(std::size_t i, BucketNode* node)
-  {
-    auto height = node->mHeight;
-    if(height == 0)
-    {
-      return std::get<BucketNode::LeafNodeIndex>(node->mBucket)[i % BucketNode::sBucketSize];
-    }
-    auto size = pow(BucketNode::sBucketSize, height);
-    auto& data = std::get<BucketNode::InnerNodeIndex>(node->mBucket);
-    auto& child = data[i / size];
-    auto childNode = child.load(std::memory_order_acquire);
-    if(childNode == nullptr)
-    {
-      auto newChild = std::make_unique<BucketNode>(height - 1);
-      BucketNode* expected = nullptr;
-      auto success = child.compare_exchange_strong(expected, newChild.get(), std::memory_order_acq_rel, std::memory_order_release);
-      if(success)
-      {
-        childNode = newChild.release();
-      }
-      else
-      {
-        childNode = expected;
-      }
-    }
-    return getImpl(i % size, childNode);
-  }
-  bool extendTree(BucketNode* root, ExponentType exp)
-  {
-    auto newHeight = root->mHeight + 1;
-    auto newRoot = std::make_unique<BucketNode>(newHeight);
-    std::get<BucketNode::InnerNodeIndex>(newRoot->mBucket)[0].store(root, std::memory_order_relaxed);
-    auto newExp = exp + 1;
-    bool success = mRoot.compare_exchange_strong(
-      root, newRoot.get(), exp, newExp, std::memory_order_release, std::memory_order_relaxed);
-    if(success)
-    {
-      newRoot.release();
-    }
-    return success;
-  }
-public:
-  LockFreeExtendibleBucket(std::size_t initialSize = BaseArraySize)
-    : mRoot(new BucketNode(0), exponent(initialSize))
-  {
-    assert(isPowersOf2(initialSize));
-  }
-  ~LockFreeExtendibleBucket()
-  {
-    auto [root, exp] = mRoot.exchange(nullptr, 0);
-    cleanupTree(root);
-  }
-  bool extend()
-  {
-    auto [root, exp] = mRoot.load();
-    auto height = root->mHeight;
-    if(1ULL << exp <= pow(BaseArraySize, height + 1))
-    {
-      // release sequences allow us to use relaxed ordering here
-      return mRoot.compare_exchange_strong(
-        root, root, exp, exp + 1, std::memory_order_relaxed, std::memory_order_relaxed);
-    }
-    return extendTree(root, exp);
-  }
-  T& operator[](std::size_t i)
-  {
-    auto [root, exp] = mRoot.load(std::memory_order_acquire);
-    return getImpl(i, root);
-  }
-  std::size_t size() const noexcept
-  {
-    auto [root, exp] = mRoot.load(std::memory_order_acquire);
-    return 1 << exp;
-  }
+  static constexpr bool sShrink = true;
 };
 
-template <typename Key, typename Value, typename Hash = std::hash<Key>, std::size_t BaseArraySize = 1 << 10>
+template <typename Key, typename Value, typename Hash = std::hash<Key>, std::size_t BaseArraySize = 1 << 10, typename Reclaimer = HazardPointerDomain<3>,
+          typename NodeAllocator = NewDeleteNodeAllocator, typename LeafAllocator = NewLeafAllocator, typename ResizePolicy = GrowOnly>
 class LockFreeHashMap
 {
 private:
   using HashValueType = decltype(std::declval<Hash>()(std::declval<const Key&>()));
   static_assert(std::is_integral_v<HashValueType>);
-  using HPDomain = HazardPointerDomain<3>;
+  using Holder = typename Reclaimer::Holder;
   static constexpr std::size_t HashValueTypeBitWidth = sizeof(HashValueType) * 8;
   static constexpr HashValueType sHiMask = static_cast<HashValueType>(3) << (HashValueTypeBitWidth - 2);
   static constexpr HashValueType sMask = ~sHiMask;
-  struct Node
+  // sentinels and both ends of the list are Node, elements are ValueNode.
+  struct Node: Reclaimer::NodeBase
   {
     HashValueType mHashValue;
-    std::optional<std::pair<Key, Value>> mValue;
     AtomicMarkablePointer<Node> mNext;
+    explicit Node(HashValueType hashValue): mHashValue(hashValue), mNext(nullptr, false) {}
   };
-  static Node* claimMarkablePointer(AtomicMarkablePointer<Node>& markablePointer, HazardPointerHolder& holder, bool* mark = nullptr)
+  struct ValueNode: Node
   {
-    Node *p, *q;
-    bool m;
-    do
+    std::pair<Key, Value> mValue;
+    ValueNode(HashValueType hashValue, const Key& key, const Value& value): Node(hashValue), mValue(key, value) {}
+  };
+  // ordinary keys end with 01, sentinel keys end with 00 and the last node has all the bits set
+  static bool isSentinel(const Node* node) noexcept
+  {
+    return (node->mHashValue & 3) != 1;
+  }
+  static std::pair<Key, Value>& getValue(Node* node) noexcept
+  {
+    assert(!isSentinel(node));
+    return static_cast<ValueNode*>(node)->mValue;
+  }
+  static void destroyNode(Node* node) noexcept
+  {
+    if(isSentinel(node))
     {
-      auto r1 = markablePointer.load(std::memory_order_seq_cst);
-      holder.store(r1.first);
-      auto r2 = markablePointer.load(std::memory_order_seq_cst);
-      p = r1.first;
-      q = r2.first;
-      m = r2.second;
+      NodeAllocator::destroy(node);
     }
-    while(p != q);
-    if(mark)
+    else
     {
-      *mark = m;
+      NodeAllocator::destroy(static_cast<ValueNode*>(node));
     }
-    return p;
   }
   class LockFreeList
   {
   public:
     std::atomic<Node*> mHead;
-    LockFreeList(HashValueType minHashValue, HashValueType maxHashValue)
+    Reclaimer& mReclaimer;
+    LockFreeList(Reclaimer& reclaimer, HashValueType minHashValue, HashValueType maxHashValue)
+      : mReclaimer(reclaimer)
     {
-      auto last = std::make_unique<Node>();
-      last->mHashValue = maxHashValue;
-      last->mNext.store(nullptr, false, std::memory_order_relaxed);
-      auto head = std::make_unique<Node>();
-      head->mHashValue = minHashValue;
+      auto last = makeNode<Node, NodeAllocator>(maxHashValue);
+      auto head = makeNode<Node, NodeAllocator>(minHashValue);
       head->mNext.store(last.release(), false, std::memory_order_relaxed);
       mHead.store(head.release(), std::memory_order_release);
     }
@@ -226,20 +101,22 @@ private:
       while(cur)
       {
         auto [next, mark] = cur->mNext.load(std::memory_order_acquire);
-        delete cur;
+        destroyNode(cur);
         cur = next;
       }
     }
     static void deleter(void* data)
     {
-      delete reinterpret_cast<Node*>(data);
+      destroyNode(reinterpret_cast<Node*>(data));
     }
-    static std::tuple<Node*, Node*, HazardPointerHolder, HazardPointerHolder> find(std::atomic<Node*>& head, HashValueType hashValue, const Key* key)
+    // key is nullptr when a sentinel is searched, K is Key or a type comparable with Key, see LockFreeHashMap::find
+    template <typename K>
+    std::tuple<Node*, Node*, Holder, Holder> find(std::atomic<Node*>& head, HashValueType hashValue, const K* key)
     {
       using std::swap;
-      HazardPointerHolder predHpHolder(HPDomain::getHazardPointerForCurrentThread(0));
-      HazardPointerHolder curHpHolder(HPDomain::getHazardPointerForCurrentThread(1));
-      HazardPointerHolder succHpHolder(HPDomain::getHazardPointerForCurrentThread(2));
+      auto predHpHolder = mReclaimer.makeHolder(0);
+      auto curHpHolder = mReclaimer.makeHolder(1);
+      auto succHpHolder = mReclaimer.makeHolder(2);
       while(true)
       {
         bool retry = false;
@@ -250,10 +127,10 @@ private:
         {
           bool mark;
           auto* succ = claimMarkablePointer(cur->mNext, succHpHolder, &mark);
+          // sentinels of the buckets removed by a shrink are marked and unlinked as well as elements
           while(mark)
           {
             bool expectedMark = false;
-            assert(cur->mValue);
             retry = !pred->mNext.compare_exchange_strong(
               cur, succ, expectedMark, false, std::memory_order_release, std::memory_order_relaxed);
             if(retry)
@@ -261,7 +138,7 @@ private:
               break;
             }
             curHpHolder.store(nullptr);
-            HPDomain::retire(cur, &deleter);
+            mReclaimer.retire(cur, &deleter);
             cur = succ;
             swap(curHpHolder, succHpHolder);
             succ = claimMarkablePointer(cur->mNext, succHpHolder, &mark);
@@ -271,8 +148,8 @@ private:
             break;
           }
           if((hashValue < cur->mHashValue) ||
-             (hashValue == cur->mHashValue && !cur->mValue) || // sentinel key
-             (key && hashValue == cur->mHashValue && cur->mValue && cur->mValue->first == *key))
+             (hashValue == cur->mHashValue && isSentinel(cur)) || // sentinel key
+             (key && hashValue == cur->mHashValue && !isSentinel(cur) && getValue(cur).first == *key))
           {
             return {pred, cur, std::move(predHpHolder), std::move(curHpHolder)};
           }
@@ -283,39 +160,34 @@ private:
         }
       }
     }
-    static std::optional<Value> get(std::atomic<Node*>& head, HashValueType hashValue, const Key& key)
+    // calls fn(const Value&) while the node of key is still protected, returns false if key is absent
+    template <typename K, typename F>
+    bool visit(std::atomic<Node*>& head, HashValueType hashValue, const K& key, F& fn)
     {
-      // get is wait free
-      using std::swap;
-      HazardPointerHolder predHpHolder(HPDomain::getHazardPointerForCurrentThread(0));
-      HazardPointerHolder curHpHolder(HPDomain::getHazardPointerForCurrentThread(1));
-      HazardPointerHolder succHpHolder(HPDomain::getHazardPointerForCurrentThread(2));
-      bool mark = false;
-      auto pred = claimPointer(head, predHpHolder);
-      auto cur = claimMarkablePointer(pred->mNext, curHpHolder, &mark);
-      while(cur->mHashValue < hashValue || (cur->mHashValue == hashValue && cur->mValue->first != key))
+      // marked nodes have to be unlinked on the way, a node replaced by compute is marked and followed by the new one
+      auto [pred, cur, predHpHolder, curHpHolder] = find(head, hashValue, &key);
+      if(cur->mHashValue != hashValue || !(getValue(cur).first == key))
       {
-        auto succ = claimMarkablePointer(cur->mNext, succHpHolder, &mark);
-        pred = cur;
-        swap(predHpHolder, curHpHolder);
-        cur = succ;
-        swap(curHpHolder, succHpHolder);
+        return false;
       }
-      if(cur->mHashValue != hashValue || cur->mValue->first != key || mark)
-      {
-        return std::nullopt;
-      }
-      return cur->mValue->second;
+      fn(static_cast<const Value&>(getValue(cur).second));
+      return true;
     }
-    static bool add(std::atomic<Node*>& head, HashValueType hashValue, const Key& key, const Value& value)
+    template <typename K>
+    std::optional<Value> get(std::atomic<Node*>& head, HashValueType hashValue, const K& key)
     {
-      auto newNode = std::make_unique<Node>();
-      newNode->mHashValue = hashValue;
-      newNode->mValue = std::make_pair(key, value);
+      std::optional<Value> ans;
+      auto fn = [&ans](const Value& value) { ans = value; };
+      visit(head, hashValue, key, fn);
+      return ans;
+    }
+    bool add(std::atomic<Node*>& head, HashValueType hashValue, const Key& key, const Value& value)
+    {
+      auto newNode = makeNode<ValueNode, NodeAllocator>(hashValue, key, value);
       while(true)
       {
         auto [pred, cur, predHpHolder, curHpHolder] = find(head, hashValue, &key);
-        if(cur->mHashValue == hashValue && cur->mValue->first == key)
+        if(cur->mHashValue == hashValue && getValue(cur).first == key)
         {
           return false;
         }
@@ -330,16 +202,161 @@ private:
         }
       }
     }
-    static bool remove(std::atomic<Node*>& head, HashValueType hashValue, const Key& key)
+    // sets the element of key to fn(current), where current points to the current value or is nullptr if key is absent.
+    // The element is removed, or not inserted, if fn returns std::nullopt.
+    // An existing element is replaced by marking cur->mNext and pointing it to the new node with a single CAS,
+    // so readers see either the old or the new value and never miss the key.
+    // Returns the new value and the change of the number of elements.
+    template <typename F>
+    std::pair<std::optional<Value>, int> compute(std::atomic<Node*>& head, HashValueType hashValue, const Key& key, F& fn)
+    {
+      NodePtr<ValueNode, NodeAllocator> newNode;
+      while(true)
+      {
+        auto [pred, cur, predHpHolder, curHpHolder] = find(head, hashValue, &key);
+        bool found = cur->mHashValue == hashValue && getValue(cur).first == key;
+        std::optional<Value> newValue = fn(found ? static_cast<const Value*>(&getValue(cur).second) : nullptr);
+        if(!found && !newValue)
+        {
+          return {std::nullopt, 0};
+        }
+        auto [succ, mark] = found ? cur->mNext.load(std::memory_order_acquire) : std::make_pair(cur, false);
+        if(mark)
+        {
+          // cur is being removed or replaced, the next find unlinks it
+          continue;
+        }
+        if(newValue)
+        {
+          if(newNode)
+          {
+            newNode->mValue.second = *newValue;
+          }
+          else
+          {
+            newNode = makeNode<ValueNode, NodeAllocator>(hashValue, key, *newValue);
+          }
+          newNode->mNext.store(succ, false, std::memory_order_relaxed);
+        }
+        bool expectedMark = false;
+        if(!found)
+        {
+          if(pred->mNext.compare_exchange_strong(
+              cur, newNode.get(), expectedMark, false, std::memory_order_release, std::memory_order_relaxed))
+          {
+            newNode.release();
+            return {std::move(newValue), 1};
+          }
+          continue;
+        }
+        auto replacement = newValue ? newNode.get() : succ;
+        if(!cur->mNext.compare_exchange_strong(
+            succ, replacement, expectedMark, true, std::memory_order_release, std::memory_order_relaxed))
+        {
+          continue;
+        }
+        if(newValue)
+        {
+          newNode.release();
+        }
+        expectedMark = false;
+        if(pred->mNext.compare_exchange_strong(
+           cur, replacement, expectedMark, false, std::memory_order_release, std::memory_order_relaxed))
+        {
+          curHpHolder.store(nullptr);
+          mReclaimer.retire(cur, &deleter);
+        }
+        auto diff = newValue ? 0 : -1;
+        return {std::move(newValue), diff};
+      }
+    }
+    // visits the elements whose hash values are in [begin, end), or to the last node if end is 0, starting from sentinel whose key is not greater than begin.
+    // An element which stays in the list during the walk is visited once, elements inserted or removed concurrently may or may not be visited.
+    // The sentinels of the first bucketCount buckets are not retired during the walk, see LockFreeHashMap::OperationGuard.
+    template <typename F>
+    void forEach(Node* sentinel, HashValueType begin, HashValueType end, std::size_t bucketCount, F& fn)
+    {
+      using std::swap;
+      auto predHpHolder = mReclaimer.makeHolder(0);
+      auto curHpHolder = mReclaimer.makeHolder(1);
+      auto succHpHolder = mReclaimer.makeHolder(2);
+      std::optional<HashValueType> lastVisited;
+      std::optional<HashValueType> resumeAfter;
+      while(true)
+      {
+        bool retry = false;
+        // the walk restarts from the last sentinel passed which can not be retired
+        Node* pred = sentinel;
+        auto* cur = claimMarkablePointer(pred->mNext, curHpHolder);
+        while(cur && (end == 0 || cur->mHashValue < end))
+        {
+          bool mark;
+          auto* succ = claimMarkablePointer(cur->mNext, succHpHolder, &mark);
+          // succ may have been retired when it was protected unless cur is still linked from pred
+          if(pred->mNext.load(std::memory_order_seq_cst) != std::make_pair(cur, false))
+          {
+            retry = true;
+            break;
+          }
+          if(mark)
+          {
+            bool expectedMark = false;
+            if(!pred->mNext.compare_exchange_strong(
+                cur, succ, expectedMark, false, std::memory_order_release, std::memory_order_relaxed))
+            {
+              retry = true;
+              break;
+            }
+            curHpHolder.store(nullptr);
+            mReclaimer.retire(cur, &deleter);
+            cur = succ;
+            swap(curHpHolder, succHpHolder);
+            continue;
+          }
+          if(isSentinel(cur))
+          {
+            if(reverse(cur->mHashValue) < bucketCount)
+            {
+              sentinel = cur;
+            }
+          }
+          else if(begin <= cur->mHashValue && (!resumeAfter || *resumeAfter < cur->mHashValue))
+          {
+            auto& value = getValue(cur);
+            fn(static_cast<const Key&>(value.first), static_cast<const Value&>(value.second));
+            lastVisited = cur->mHashValue;
+          }
+          pred = cur;
+          swap(predHpHolder, curHpHolder);
+          cur = succ;
+          swap(curHpHolder, succHpHolder);
+        }
+        if(!retry)
+        {
+          return;
+        }
+        // elements visited before the restart are skipped by their hash values,
+        // so an element whose hash value collides with the last visited one may be missed.
+        resumeAfter = lastVisited;
+      }
+    }
+    template <typename K>
+    bool remove(std::atomic<Node*>& head, HashValueType hashValue, const K& key)
+    {
+      auto always = [](const Value&) { return true; };
+      return removeIf(head, hashValue, key, always);
+    }
+    // the value is checked again if the element is replaced before it is marked
+    template <typename K, typename Predicate>
+    bool removeIf(std::atomic<Node*>& head, HashValueType hashValue, const K& key, Predicate& predicate)
     {
       while(true)
       {
         auto [pred, cur, predHpHolder, curHpHolder] = find(head, hashValue, &key);
-        if(cur->mHashValue != hashValue || cur->mValue->first != key)
+        if(cur->mHashValue != hashValue || !(getValue(cur).first == key) || !predicate(static_cast<const Value&>(getValue(cur).second)))
         {
           return false;
         }
-        assert(cur->mValue);
         auto [succ, mark] = cur->mNext.load(std::memory_order_acquire);
         mark = false;
         if(!cur->mNext.compare_exchange_strong(
@@ -351,7 +368,7 @@ private:
            cur, succ, mark, false, std::memory_order_release, std::memory_order_relaxed))
         {
           curHpHolder.store(nullptr);
-          HPDomain::retire(cur, &deleter);
+          mReclaimer.retire(cur, &deleter);
         }
         return true;
       }
@@ -384,12 +401,62 @@ private:
       elem.store(nullptr, std::memory_order_relaxed);
     }
   };
-  using Buckets = LockFreeExtendibleBucket<std::atomic<Node*>, BaseArraySize, BucketElementInitializer>;
+  using Buckets = LockFreeExtendibleBucket<std::atomic<Node*>, BaseArraySize, BucketElementInitializer, LeafAllocator>;
   LockFreeList mList;
   Buckets mBuckets;
-  std::atomic<unsigned int> mSize;
+  ShardedCounter mSize;
   Hash mHash; // TODO: EBO
+  static constexpr bool sShrink = ResizePolicy::sShrink;
+  struct ShrinkState
+  {
+    // operations in flight are counted by the parity of the generation in which they started, see OperationGuard
+    std::atomic<std::uint64_t> mGeneration{0};
+    ShardedCounter mActiveOperations[2];
+    std::size_t mRetiredBucketBegin = 0; // the bucket count after the last shrink if its sentinels are not retired yet, otherwise 0
+    std::uint64_t mRetiredGeneration = 0; // the generation before the last shrink
+  };
+  struct NoShrinkState {};
+  // only the thread which sets mResizing changes the bucket count and mShrinkState except for the active operations
+  std::atomic<bool> mResizing;
+  std::conditional_t<sShrink, ShrinkState, NoShrinkState> mShrinkState;
 private:
+  // every operation which reads the bucket count holds a guard, so that the buckets removed by a shrink are not retired
+  // until all the operations which may have seen the old bucket count finish. Operations never wait for the guard.
+  // The guard does nothing if the map does not shrink.
+  class OperationGuard
+  {
+  private:
+    ShardedCounter* mActiveOperations = nullptr;
+  public:
+    explicit OperationGuard(LockFreeHashMap& map)
+    {
+      if constexpr(sShrink)
+      {
+        auto& state = map.mShrinkState;
+        while(true)
+        {
+          auto generation = state.mGeneration.load(std::memory_order_seq_cst);
+          mActiveOperations = &state.mActiveOperations[generation & 1];
+          mActiveOperations->add(1, std::memory_order_seq_cst);
+          // a shrink which did not see the increment has changed the generation
+          if(state.mGeneration.load(std::memory_order_seq_cst) == generation)
+          {
+            return;
+          }
+          mActiveOperations->add(-1, std::memory_order_release);
+        }
+      }
+    }
+    ~OperationGuard()
+    {
+      if constexpr(sShrink)
+      {
+        mActiveOperations->add(-1, std::memory_order_release);
+      }
+    }
+    OperationGuard(const OperationGuard&) = delete;
+    OperationGuard& operator=(const OperationGuard&) = delete;
+  };
   HashValueType getParentIndex(HashValueType index, HashValueType bucketSize)
   {
     auto i = bucketSize;
@@ -409,12 +476,11 @@ private:
       insertSentinel(parentIndex, bucketSize);
     }
     auto sentinelKey = makeSentinelKey(index);
-    auto newNode = std::make_unique<Node>();
-    newNode->mHashValue = sentinelKey;
+    auto newNode = makeNode<Node, NodeAllocator>(sentinelKey);
     Node* sentinelNode;
     while(true)
     {
-      auto [pred, cur, predHpHolder, curHpHolder] = LockFreeList::find(parent, sentinelKey, nullptr);
+      auto [pred, cur, predHpHolder, curHpHolder] = mList.find(parent, sentinelKey, static_cast<const Key*>(nullptr));
       if(cur->mHashValue == sentinelKey)
       {
         sentinelNode = cur;
@@ -435,7 +501,8 @@ private:
       mBuckets[index].store(sentinelNode, std::memory_order_release);
     }
   }
-  std::atomic<Node*>& getSentinelNode(const Key& key)
+  template <typename K>
+  std::atomic<Node*>& getSentinelNode(const K& key)
   {
     auto bucketSize = mBuckets.size();
     auto hashValue = mHash(key);
@@ -448,12 +515,345 @@ private:
     }
     return sentinel;
   }
+  // the keys of findMany are resolved in groups of this size, the prefetched lines of a group have to fit in L1
+  static constexpr std::size_t sFindManyGroupSize = 16;
+  static void prefetch(const void* p) noexcept
+  {
+#if defined(__GNUC__)
+    __builtin_prefetch(p);
+#endif
+  }
   static constexpr std::size_t sThreshold = 2;
+  // the bucket count is halved when there are more buckets than sShrinkThreshold times the elements
+  static constexpr std::size_t sShrinkThreshold = 8;
+  static constexpr std::size_t sMinBucketCount = 2;
+  // the size is summed up only on sampled updates, which have to be called outside of OperationGuard
+  void onInserted()
+  {
+    if(mSize.addAndSample(1))
+    {
+      resize();
+    }
+  }
+  void onRemoved()
+  {
+    if constexpr(!sShrink)
+    {
+      // only a growth can be due
+      mSize.add(-1);
+    }
+    else if(mSize.addAndSample(-1))
+    {
+      resize();
+    }
+  }
+  // grows or shrinks the bucket directory as many times as the size needs, retiring the sentinels of each shrink.
+  // Samples are sparse, so a single call catches up with all the updates since the last one.
+  // A thread which finds another one resizing skips it instead of waiting.
+  void resize()
+  {
+    if(mResizing.exchange(true, std::memory_order_acquire))
+    {
+      return;
+    }
+    auto size = static_cast<std::size_t>(mSize.load());
+    while(true)
+    {
+      auto bucketCount = mBuckets.size();
+      if(size / bucketCount > sThreshold)
+      {
+        if constexpr(sShrink)
+        {
+          // the sentinels of an unfinished shrink are still linked, the buckets just use them again
+          mShrinkState.mRetiredBucketBegin = 0;
+        }
+        mBuckets.extend();
+        continue;
+      }
+      if constexpr(sShrink)
+      {
+        auto& state = mShrinkState;
+        if(state.mRetiredBucketBegin)
+        {
+          retireSentinels();
+          if(state.mRetiredBucketBegin)
+          {
+            // operations which started before the last shrink are still running
+            break;
+          }
+          continue;
+        }
+        if(sMinBucketCount < bucketCount && size * sShrinkThreshold < bucketCount)
+        {
+          auto generation = state.mGeneration.load(std::memory_order_relaxed);
+          // the parity of the next generation may still count operations which started before an unfinished shrink
+          if(state.mActiveOperations[(generation + 1) & 1].load(std::memory_order_seq_cst) == 0)
+          {
+            [[maybe_unused]] auto shrunk = mBuckets.shrink();
+            assert(shrunk);
+            state.mRetiredBucketBegin = bucketCount / 2;
+            state.mRetiredGeneration = state.mGeneration.fetch_add(1, std::memory_order_seq_cst);
+            continue;
+          }
+        }
+      }
+      break;
+    }
+    mResizing.store(false, std::memory_order_release);
+  }
+  // unlinks and retires the sentinels of the buckets removed by the last shrink and frees the directory nodes which only hold them.
+  // Nothing is done while operations which started before the shrink are running, one of the later resize calls retries it.
+  void retireSentinels()
+  {
+    auto& state = mShrinkState;
+    if(state.mActiveOperations[state.mRetiredGeneration & 1].load(std::memory_order_seq_cst) != 0)
+    {
+      return;
+    }
+    std::vector<Node*> sentinels;
+    mBuckets.releaseFrom(state.mRetiredBucketBegin, [&sentinels](std::atomic<Node*>& bucket) {
+      if(auto sentinel = bucket.exchange(nullptr, std::memory_order_relaxed))
+      {
+        sentinels.push_back(sentinel);
+      }
+    });
+    for(auto sentinel: sentinels)
+    {
+      // only this thread marks sentinels, the CAS fails only if a node is inserted after the sentinel
+      auto [succ, mark] = sentinel->mNext.load(std::memory_order_relaxed);
+      while(!sentinel->mNext.compare_exchange_weak(succ, succ, mark, true, std::memory_order_release, std::memory_order_relaxed))
+      {
+        assert(!mark);
+      }
+      // the list is searched from a remaining bucket before the sentinel, which unlinks and retires the marked one
+      auto sentinelKey = sentinel->mHashValue;
+      auto index = reverse(sentinelKey) & (state.mRetiredBucketBegin - 1);
+      while(mBuckets[index].load(std::memory_order_acquire) == nullptr)
+      {
+        index = getParentIndex(index, state.mRetiredBucketBegin);
+      }
+      mList.find(mBuckets[index], sentinelKey, static_cast<const Key*>(nullptr));
+    }
+    state.mRetiredBucketBegin = 0;
+  }
+  // runs fn(begin, end) on threadNum threads for the disjoint ranges which cover [0, n), exceptions are rethrown after all the threads finish.
+  template <typename F>
+  static void parallelFor(std::size_t threadNum, std::size_t n, F fn)
+  {
+    std::vector<std::future<void>> futures;
+    for(std::size_t i = 1; i < threadNum; ++i)
+    {
+      futures.push_back(std::async(std::launch::async, [&fn, begin = n * i / threadNum, end = n * (i + 1) / threadNum]() { fn(begin, end); }));
+    }
+    std::exception_ptr error;
+    try
+    {
+      fn(0, n / threadNum);
+    }
+    catch(...)
+    {
+      error = std::current_exception();
+    }
+    for(auto& fut: futures)
+    {
+      try
+      {
+        fut.get();
+      }
+      catch(...)
+      {
+        if(!error)
+        {
+          error = std::current_exception();
+        }
+      }
+    }
+    if(error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+  template <typename ForwardIterator>
+  void bulkLoad(ForwardIterator first, ForwardIterator last, std::size_t threadNum)
+  {
+    static constexpr std::size_t sMinElementsPerThread = 1 << 12;
+    using Entry = std::pair<HashValueType, ForwardIterator>;
+    std::vector<Entry> entries;
+    for(; first != last; ++first)
+    {
+      entries.emplace_back(0, first);
+    }
+    auto n = entries.size();
+    threadNum = std::max<std::size_t>(1, std::min(threadNum, n / sMinElementsPerThread));
+    while(mBuckets.size() * sThreshold < n)
+    {
+      mBuckets.extend();
+    }
+    // each thread sorts its own range, then sorted ranges are merged pairwise in parallel
+    std::vector<std::size_t> bounds;
+    for(std::size_t i = 0; i <= threadNum; ++i)
+    {
+      bounds.push_back(n * i / threadNum);
+    }
+    auto byKey = [](const Entry& x, const Entry& y) { return x.first < y.first; };
+    parallelFor(threadNum, threadNum, [&](std::size_t begin, std::size_t end) {
+      for(auto i = begin; i < end; ++i)
+      {
+        for(auto j = bounds[i]; j < bounds[i + 1]; ++j)
+        {
+          entries[j].first = makeOrdinaryKey(mHash(entries[j].second->first));
+        }
+        std::stable_sort(entries.begin() + bounds[i], entries.begin() + bounds[i + 1], byKey);
+      }
+    });
+    for(std::size_t width = 1; width < threadNum; width *= 2)
+    {
+      auto pairNum = (threadNum + 2 * width - 1) / (2 * width);
+      parallelFor(pairNum, pairNum, [&](std::size_t begin, std::size_t end) {
+        for(auto i = begin; i < end; ++i)
+        {
+          auto lo = 2 * width * i;
+          auto mid = std::min(lo + width, threadNum);
+          auto hi = std::min(lo + 2 * width, threadNum);
+          std::inplace_merge(entries.begin() + bounds[lo], entries.begin() + bounds[mid], entries.begin() + bounds[hi], byKey);
+        }
+      });
+    }
+    // duplicated keys have the same split ordered key, the sort is stable so that the first one is kept
+    std::size_t size = 0;
+    for(std::size_t i = 0; i < n; ++i)
+    {
+      bool duplicated = false;
+      for(auto j = size; 0 < j && entries[j - 1].first == entries[i].first; --j)
+      {
+        if(entries[j - 1].second->first == entries[i].second->first)
+        {
+          duplicated = true;
+          break;
+        }
+      }
+      if(!duplicated)
+      {
+        entries[size++] = entries[i];
+      }
+    }
+    entries.resize(size);
+    // the sentinel key of the j-th bucket in the split order is j << (the bit width - log2(bucket count))
+    auto bucketCount = mBuckets.size();
+    std::size_t shift = HashValueTypeBitWidth;
+    for(auto b = bucketCount; 1 < b; b >>= 1)
+    {
+      --shift;
+    }
+    auto head = mList.mHead.load(std::memory_order_relaxed);
+    auto [tail, tailMark] = head->mNext.load(std::memory_order_relaxed);
+    std::vector<Node*> nodes(size, nullptr);
+    std::vector<Node*> sentinels(bucketCount, nullptr);
+    try
+    {
+      parallelFor(threadNum, size, [&](std::size_t begin, std::size_t end) {
+        for(auto i = begin; i < end; ++i)
+        {
+          nodes[i] = NodeAllocator::template create<ValueNode>(entries[i].first, entries[i].second->first, entries[i].second->second);
+        }
+      });
+      parallelFor(threadNum, bucketCount, [&](std::size_t begin, std::size_t end) {
+        for(auto j = std::max<std::size_t>(begin, 1); j < end; ++j)
+        {
+          sentinels[j] = NodeAllocator::template create<Node>(static_cast<HashValueType>(j) << shift);
+        }
+      });
+    }
+    catch(...)
+    {
+      std::for_each(nodes.begin(), nodes.end(), [](Node* node) { if(node) destroyNode(node); });
+      std::for_each(sentinels.begin(), sentinels.end(), [](Node* node) { if(node) destroyNode(node); });
+      throw;
+    }
+    sentinels[0] = head;
+    Node* pred = head;
+    for(std::size_t i = 0, j = 1; i < size || j < bucketCount;)
+    {
+      Node* next;
+      if(j < bucketCount && (size <= i || sentinels[j]->mHashValue < nodes[i]->mHashValue))
+      {
+        next = sentinels[j];
+        mBuckets[reverse(next->mHashValue)].store(next, std::memory_order_relaxed);
+        ++j;
+      }
+      else
+      {
+        next = nodes[i++];
+      }
+      pred->mNext.store(next, false, std::memory_order_relaxed);
+      pred = next;
+    }
+    pred->mNext.store(tail, false, std::memory_order_release);
+    mSize.add(size);
+  }
+  template <typename K>
+  std::optional<Value> findImpl(const K& key)
+  {
+    OperationGuard guard(*this);
+    auto& sentinel = getSentinelNode(key);
+    auto splitOrderedKey = makeOrdinaryKey(mHash(key));
+    return mList.get(sentinel, splitOrderedKey, key);
+  }
+  template <typename K, typename F>
+  bool visitImpl(const K& key, F& fn)
+  {
+    OperationGuard guard(*this);
+    auto& sentinel = getSentinelNode(key);
+    auto splitOrderedKey = makeOrdinaryKey(mHash(key));
+    return mList.visit(sentinel, splitOrderedKey, key, fn);
+  }
+  template <typename K>
+  bool removeImpl(const K& key)
+  {
+    {
+      OperationGuard guard(*this);
+      auto& sentinel = getSentinelNode(key);
+      auto splitOrderedKey = makeOrdinaryKey(mHash(key));
+      if(!mList.remove(sentinel, splitOrderedKey, key))
+      {
+        return false;
+      }
+    }
+    onRemoved();
+    return true;
+  }
+  template <typename F>
+  std::optional<Value> computeImpl(const Key& key, F& fn, int* sizeDiff = nullptr)
+  {
+    std::optional<Value> value;
+    int diff;
+    {
+      OperationGuard guard(*this);
+      auto& sentinel = getSentinelNode(key);
+      auto splitOrderedKey = makeOrdinaryKey(mHash(key));
+      std::tie(value, diff) = mList.compute(sentinel, splitOrderedKey, key, fn);
+    }
+    if(0 < diff)
+    {
+      onInserted();
+    }
+    else if(diff < 0)
+    {
+      onRemoved();
+    }
+    if(sizeDiff)
+    {
+      *sizeDiff = diff;
+    }
+    return value;
+  }
 public:
-  LockFreeHashMap()
-    : mList(0, ~static_cast<HashValueType>(0))
-    , mBuckets(2)
-    , mSize(0)
+  explicit LockFreeHashMap(Reclaimer& reclaimer = Reclaimer::defaultDomain())
+    : mList(reclaimer, 0, ~static_cast<HashValueType>(0))
+    , mBuckets(sMinBucketCount)
+    , mSize()
+    , mResizing(false)
+    , mShrinkState()
   {
     auto sz = mBuckets.size();
     for(std::size_t i = 0; i < sz; ++i)
@@ -463,40 +863,185 @@ public:
     auto head = mList.mHead.load(std::memory_order_relaxed);
     mBuckets[0].store(head, std::memory_order_release);
   }
+  // builds the map from the elements in [first, last) without any CAS, the elements are pairs of a key and a value.
+  // The bucket directory is presized for the number of elements, the elements are sorted by their split ordered keys with threadNum threads
+  // and the whole list is linked in one pass with the sentinels of all the buckets.
+  // The first one of elements with the same key is kept. Other threads must not use the map until the constructor returns.
+  template <typename ForwardIterator>
+  LockFreeHashMap(ForwardIterator first, ForwardIterator last,
+                  std::size_t threadNum = std::thread::hardware_concurrency(), Reclaimer& reclaimer = Reclaimer::defaultDomain())
+    : LockFreeHashMap(reclaimer)
+  {
+    bulkLoad(first, last, threadNum);
+  }
   bool insert(const std::pair<Key, Value>& elem)
   {
-    auto& sentinel = getSentinelNode(elem.first);
-    auto splitOrderedKey = makeOrdinaryKey(mHash(elem.first));
-    if(!LockFreeList::add(sentinel, splitOrderedKey, elem.first, elem.second))
     {
-      return false;
-    }
-    auto prevSize = mSize.fetch_add(1, std::memory_order_relaxed);
-    auto curBucketSize = mBuckets.size();
-    if(prevSize / curBucketSize > sThreshold)
-    {
-      mBuckets.extend();
+      OperationGuard guard(*this);
+      auto& sentinel = getSentinelNode(elem.first);
+      auto splitOrderedKey = makeOrdinaryKey(mHash(elem.first));
+      if(!mList.add(sentinel, splitOrderedKey, elem.first, elem.second))
+      {
+        return false;
+      }
     }
+    onInserted();
     return true;
   }
   bool remove(const Key& key)
   {
-    auto& sentinel = getSentinelNode(key);
-    auto splitOrderedKey = makeOrdinaryKey(mHash(key));
-    if(!LockFreeList::remove(sentinel, splitOrderedKey, key))
+    return removeImpl(key);
+  }
+  // find and remove accept any key type comparable with Key by operator== if Hash::is_transparent is defined,
+  // the hash value of such a key has to be the same as the one of the equal Key.
+  template <typename K, typename H = Hash, typename = typename H::is_transparent>
+  bool remove(const K& key)
+  {
+    return removeImpl(key);
+  }
+  std::optional<Value> find(const Key& key)
+  {
+    return findImpl(key);
+  }
+  template <typename K, typename H = Hash, typename = typename H::is_transparent>
+  std::optional<Value> find(const K& key)
+  {
+    return findImpl(key);
+  }
+  // looks up the keys in [first, last) and writes a std::optional<Value> per key to out, as find does for each of them.
+  // The keys are resolved in groups, the bucket slots, the sentinels and the first nodes after them of a whole group are prefetched
+  // before any list of the group is walked, so that the cache misses of independent keys overlap instead of being serialized.
+  template <typename ForwardIterator, typename OutputIterator>
+  OutputIterator findMany(ForwardIterator first, ForwardIterator last, OutputIterator out)
+  {
+    std::array<HashValueType, sFindManyGroupSize> hashValues;
+    std::array<std::atomic<Node*>*, sFindManyGroupSize> sentinels;
+    while(first != last)
+    {
+      // a guard per group, so that a long batch does not hold back the retirement after a shrink
+      OperationGuard guard(*this);
+      auto bucketSize = mBuckets.size();
+      auto groupFirst = first;
+      std::size_t n = 0;
+      for(; n < sFindManyGroupSize && first != last; ++n, ++first)
+      {
+        hashValues[n] = mHash(*first);
+        sentinels[n] = &mBuckets[hashValues[n] % bucketSize];
+        prefetch(sentinels[n]);
+      }
+      for(std::size_t i = 0; i < n; ++i)
+      {
+        if(auto sentinel = sentinels[i]->load(std::memory_order_acquire))
+        {
+          prefetch(sentinel);
+        }
+      }
+      for(std::size_t i = 0; i < n; ++i)
+      {
+        // the sentinels of the current buckets are not retired while the guard is held, the first node is only a hint
+        if(auto sentinel = sentinels[i]->load(std::memory_order_acquire))
+        {
+          prefetch(sentinel->mNext.load(std::memory_order_relaxed).first);
+        }
+      }
+      for(std::size_t i = 0; i < n; ++i, ++groupFirst)
+      {
+        if(sentinels[i]->load(std::memory_order_acquire) == nullptr)
+        {
+          insertSentinel(hashValues[i] % bucketSize, bucketSize);
+        }
+        *out = mList.get(*sentinels[i], makeOrdinaryKey(hashValues[i]), *groupFirst);
+        ++out;
+      }
+    }
+    return out;
+  }
+  // calls fn(const Value&) with the value of key instead of copying it out, returns false if key is absent.
+  // The node is protected by the reclaimer while fn runs, so fn should be short and must not keep the reference.
+  // A value is never modified in place, so fn sees the value of a single insert or compute even if the key is updated meanwhile.
+  template <typename F>
+  bool visit(const Key& key, F&& fn)
+  {
+    return visitImpl(key, fn);
+  }
+  template <typename K, typename F, typename H = Hash, typename = typename H::is_transparent>
+  bool visit(const K& key, F&& fn)
+  {
+    return visitImpl(key, fn);
+  }
+  // inserts elem, or replaces the value if the key exists. Returns true if elem is inserted.
+  bool insert_or_assign(const std::pair<Key, Value>& elem)
+  {
+    auto fn = [&elem](const Value*) { return std::optional<Value>(elem.second); };
+    int sizeDiff;
+    computeImpl(elem.first, fn, &sizeDiff);
+    return sizeDiff == 1;
+  }
+  // atomically inserts, replaces or removes the element of key and returns the new value.
+  // fn(const Value* current) gets nullptr if key is absent and returns std::optional<Value>, std::nullopt removes the element.
+  // fn may be called more than once under contention, so it should not have side effects.
+  template <typename F>
+  std::optional<Value> compute(const Key& key, F&& fn)
+  {
+    return computeImpl(key, fn);
+  }
+  // removes the element of key if pred(const Value&) returns true for its current value.
+  template <typename Predicate>
+  bool erase_if(const Key& key, Predicate&& pred)
+  {
     {
-      return false;
+      OperationGuard guard(*this);
+      auto& sentinel = getSentinelNode(key);
+      auto splitOrderedKey = makeOrdinaryKey(mHash(key));
+      if(!mList.removeIf(sentinel, splitOrderedKey, key, pred))
+      {
+        return false;
+      }
     }
-    mSize.fetch_add(-1, std::memory_order_relaxed);
+    onRemoved();
     return true;
   }
-  std::optional<Value> find(const Key& key)
+  // weakly consistent iteration without locks, fn(const Key&, const Value&) is called for each element.
+  // Elements inserted or removed during the iteration may or may not be visited.
+  template <typename F>
+  void for_each(F&& fn)
   {
-    auto& sentinel = getSentinelNode(key);
-    auto splitOrderedKey = makeOrdinaryKey(mHash(key));
-    return LockFreeList::get(sentinel, splitOrderedKey, key);
+    for_each(0, 1, std::forward<F>(fn));
+  }
+  // visits the elements of the partition-th range when the buckets are split into partitionNum disjoint ranges,
+  // so that several threads can scan the map in parallel. partitionNum has to be a power of 2,
+  // a partition starts at its own sentinel if partitionNum is not greater than bucketCount(), which may shrink concurrently.
+  template <typename F>
+  void for_each(std::size_t partition, std::size_t partitionNum, F&& fn)
+  {
+    assert(partition < partitionNum && (partitionNum & (partitionNum - 1)) == 0);
+    OperationGuard guard(*this);
+    auto bucketCount = mBuckets.size();
+    HashValueType begin = 0;
+    HashValueType end = 0;
+    if(1 < partitionNum)
+    {
+      // the partition-th range in the split order starts at the sentinel key partition << shift
+      std::size_t shift = HashValueTypeBitWidth;
+      for(auto n = partitionNum; 1 < n; n >>= 1)
+      {
+        --shift;
+      }
+      begin = static_cast<HashValueType>(partition) << shift;
+      end = partition + 1 < partitionNum ? static_cast<HashValueType>(partition + 1) << shift : 0;
+    }
+    // the bucket of begin, whose sentinel key is not greater than begin
+    HashValueType index = reverse(begin) & (bucketCount - 1);
+    auto& bucket = mBuckets[index];
+    if(bucket.load(std::memory_order_acquire) == nullptr)
+    {
+      insertSentinel(index, bucketCount);
+    }
+    mList.forEach(bucket.load(std::memory_order_acquire), begin, end, bucketCount, fn);
   }
-  std::size_t size() const noexcept { return mSize.load(std::memory_order_relaxed); }
-  bool empty() const noexcept { return mSize.load(std::memory_order_relaxed) == 0; }
+  std::size_t bucketCount() const noexcept { return mBuckets.size(); }
+  // approximate while other threads modify the map
+  std::size_t size() const noexcept { return mSize.load(); }
+  bool empty() const noexcept { return mSize.load() == 0; }
 };
 
@@ -0,0 +1,426 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "HazardPointer.hpp"
+#include "ShardedCounter.hpp"
+
+// Lock free hash map with linear probing for integral keys and values, the keys and the values are stored inline in arrays of atomic slots.
+// The key of a slot changes only once, from empty to a key or to closed, so a slot is never reused for another key.
+// The value of a slot is sAbsentValue while the key is not in the map, a key is inserted or removed by a CAS on the value only.
+// The map grows by chaining tables: when the newest table gets too full, a new table sized for twice the live keys is appended and new keys go there.
+// Writers then help to move the oldest table to the newer ones by chunks of slots: the value of a moved slot becomes sMovedValue
+// and operations which see it go on to the next table. A table whose slots are all moved is unlinked and retired to Reclaimer,
+// so the removed keys do not pile up in the old tables and the chain stays short under churn.
+// Reclaimer is HazardPointerDomain<2> or any other domain which has the same interface, the walk over the tables needs two protected pointers at a time.
+// The largest key and the one below, and the largest value and the one below are reserved.
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename Reclaimer = HazardPointerDomain<2>>
+class LockFreeOpenAddressingHashMap
+{
+  static_assert(std::is_integral_v<Key> && std::is_integral_v<Value>);
+public:
+  static constexpr Key sEmptyKey = std::numeric_limits<Key>::max();
+  static constexpr Key sClosedKey = std::numeric_limits<Key>::max() - 1;
+  static constexpr Value sAbsentValue = std::numeric_limits<Value>::max();
+  static constexpr Value sMovedValue = std::numeric_limits<Value>::max() - 1;
+private:
+  // the number of slots which a writer moves to the newer tables at a time
+  static constexpr std::size_t sMigrationChunkSize = 1024;
+  struct Slot
+  {
+    std::atomic<Key> mKey;
+    std::atomic<Value> mValue;
+    Slot() noexcept: mKey(sEmptyKey), mValue(sAbsentValue) {}
+  };
+  struct Table: Reclaimer::NodeBase
+  {
+    std::size_t mCapacity;
+    unsigned int mShift;
+    std::atomic<std::size_t> mCount; // the number of slots which have a key or are closed
+    std::atomic<Table*> mNext;
+    std::atomic<std::size_t> mMigrationCursor; // the first slot which no writer has started to move yet
+    std::atomic<std::size_t> mMigratedSlots;
+    std::atomic<bool> mUnlinked; // set before mFirst moves past this table
+    std::unique_ptr<Slot[]> mSlots;
+    explicit Table(std::size_t capacity)
+      : mCapacity(capacity), mShift(64), mCount(0), mNext(nullptr), mMigrationCursor(0), mMigratedSlots(0), mUnlinked(false), mSlots(new Slot[capacity])
+    {
+      assert(capacity && (capacity & (capacity - 1)) == 0);
+      for(auto c = capacity; 1 < c; c >>= 1)
+      {
+        --mShift;
+      }
+    }
+    // new keys do not go to a table which is 3/4 full
+    bool isFull() const noexcept
+    {
+      return mCapacity - mCapacity / 4 <= mCount.load(std::memory_order_relaxed);
+    }
+  };
+  enum class ProbeResult
+  {
+    Found, // the slot has the key
+    Claimed, // the key is set to an empty slot by this call
+    NotFound // the probe reached an empty or a closed slot, the key is not in this table and can not be inserted to it
+  };
+  std::atomic<Table*> mFirst;
+  std::atomic<std::size_t> mTableCount; // the number of linked tables, writers only help the migration while it is more than one
+  std::size_t mMinCapacity;
+  ShardedCounter mSize;
+  Hash mHash; // TODO: EBO
+  Reclaimer& mReclaimer;
+  static void deleter(void* data)
+  {
+    delete static_cast<Table*>(data);
+  }
+  std::size_t getIndex(const Table& table, Key key) const
+  {
+    // Fibonacci hashing, so that std::hash of integers, which is the identity, does not make clusters
+    auto h = static_cast<std::uint64_t>(mHash(key)) * 0x9E3779B97F4A7C15ULL;
+    return table.mShift == 64 ? 0 : static_cast<std::size_t>(h >> table.mShift);
+  }
+  // looks for the slot of key in table. If claim is true, the first empty slot on the probe sequence is claimed for key,
+  // otherwise it is closed so that no other thread can insert key to this table after this call.
+  // Both an inserter and a closer compete for the same first empty slot, so a key is never inserted to two tables.
+  std::pair<ProbeResult, Slot*> probe(Table& table, Key key, bool insert, bool claim)
+  {
+    auto mask = table.mCapacity - 1;
+    auto index = getIndex(table, key);
+    for(std::size_t i = 0; i < table.mCapacity; ++i, index = (index + 1) & mask)
+    {
+      auto& slot = table.mSlots[index];
+      auto k = slot.mKey.load(std::memory_order_acquire);
+      if(k == sEmptyKey)
+      {
+        if(!insert)
+        {
+          return {ProbeResult::NotFound, nullptr};
+        }
+        if(slot.mKey.compare_exchange_strong(k, claim ? key : sClosedKey, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+          table.mCount.fetch_add(1, std::memory_order_relaxed);
+          return claim ? std::make_pair(ProbeResult::Claimed, &slot) : std::make_pair(ProbeResult::NotFound, nullptr);
+        }
+      }
+      if(k == key)
+      {
+        return {ProbeResult::Found, &slot};
+      }
+      if(k == sClosedKey)
+      {
+        return {ProbeResult::NotFound, nullptr};
+      }
+    }
+    return {ProbeResult::NotFound, nullptr};
+  }
+  // appends a table after table unless another thread has done it, the new table has room for twice the live keys
+  void appendTable(Table& table)
+  {
+    // the sharded size may be off, even negative, while other threads modify the map
+    auto size = static_cast<std::size_t>(std::max<std::int64_t>(mSize.load(), 0));
+    auto capacity = mMinCapacity;
+    while(capacity < 2 * (size + 1))
+    {
+      capacity *= 2;
+    }
+    auto newTable = std::make_unique<Table>(capacity);
+    Table* next = nullptr;
+    if(table.mNext.compare_exchange_strong(next, newTable.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+    {
+      newTable.release();
+      mTableCount.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  // the slot of key in table, claimed if table is the newest one and has room. If table has no slot for key, a newer table is appended unless there is one.
+  Slot* probeOrClaim(Table& table, Key key, ProbeResult& result)
+  {
+    auto next = table.mNext.load(std::memory_order_acquire);
+    auto [r, slot] = probe(table, key, true, !next && !table.isFull());
+    result = r;
+    if(!slot && !next)
+    {
+      appendTable(table);
+    }
+    return slot;
+  }
+  // calls fn(Table&) for the tables from the oldest one until it returns true.
+  // A table is protected before the previous one is checked to be still linked, since no table is retired before the older ones.
+  // The walk restarts from the oldest table if the previous one was unlinked meanwhile, fn is called again for the tables it has seen.
+  template <typename F>
+  void walk(F&& fn)
+  {
+    using std::swap;
+    auto hpHolder = mReclaimer.makeHolder(0);
+    auto table = claimPointer(mFirst, hpHolder);
+    if(fn(*table))
+    {
+      return;
+    }
+    auto nextHpHolder = mReclaimer.makeHolder(1);
+    while(true)
+    {
+      auto next = table->mNext.load(std::memory_order_acquire);
+      if(!next)
+      {
+        return;
+      }
+      nextHpHolder.store(next);
+      if(table->mUnlinked.load(std::memory_order_seq_cst))
+      {
+        next = claimPointer(mFirst, nextHpHolder);
+      }
+      swap(hpHolder, nextHpHolder);
+      table = next;
+      if(fn(*table))
+      {
+        return;
+      }
+    }
+  }
+  // moves the value of slot to the newer tables, next is not retired before table whose slots are being moved
+  void migrateSlot(Table& table, Slot& slot)
+  {
+    auto key = slot.mKey.load(std::memory_order_acquire);
+    if(key == sEmptyKey && slot.mKey.compare_exchange_strong(key, sClosedKey, std::memory_order_acq_rel, std::memory_order_acquire))
+    {
+      return;
+    }
+    if(key == sClosedKey)
+    {
+      return;
+    }
+    Slot* target = nullptr;
+    auto value = slot.mValue.load(std::memory_order_acquire);
+    while(value != sMovedValue)
+    {
+      if(value != sAbsentValue && !target)
+      {
+        // key is not in the newer tables until its slot here is moved
+        ProbeResult result = ProbeResult::NotFound;
+        for(auto t = table.mNext.load(std::memory_order_acquire); !(target = probeOrClaim(*t, key, result)); t = t->mNext.load(std::memory_order_acquire));
+        assert(result == ProbeResult::Claimed);
+      }
+      if(target)
+      {
+        // the target is read only after the moved value below is seen
+        target->mValue.store(value, std::memory_order_relaxed);
+      }
+      if(slot.mValue.compare_exchange_weak(value, sMovedValue, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        return;
+      }
+    }
+  }
+  // a writer moves a chunk of the oldest table if there are newer ones, the last chunk unlinks and retires the table.
+  void helpMigrate()
+  {
+    if(mTableCount.load(std::memory_order_relaxed) == 1)
+    {
+      return;
+    }
+    auto hpHolder = mReclaimer.makeHolder(0);
+    auto table = claimPointer(mFirst, hpHolder);
+    auto next = table->mNext.load(std::memory_order_acquire);
+    if(!next)
+    {
+      return;
+    }
+    auto begin = table->mMigrationCursor.fetch_add(sMigrationChunkSize, std::memory_order_relaxed);
+    if(table->mCapacity <= begin)
+    {
+      return;
+    }
+    auto end = std::min(begin + sMigrationChunkSize, table->mCapacity);
+    for(auto i = begin; i < end; ++i)
+    {
+      migrateSlot(*table, table->mSlots[i]);
+    }
+    if(table->mMigratedSlots.fetch_add(end - begin, std::memory_order_acq_rel) + (end - begin) == table->mCapacity)
+    {
+      table->mUnlinked.store(true, std::memory_order_seq_cst);
+      mFirst.store(next, std::memory_order_seq_cst);
+      mTableCount.fetch_sub(1, std::memory_order_relaxed);
+      hpHolder.release();
+      mReclaimer.retire(table, &deleter);
+    }
+  }
+public:
+  // initialCapacity is rounded up to a power of 2, a map which holds up to 3/4 of it keeps only one table.
+  explicit LockFreeOpenAddressingHashMap(std::size_t initialCapacity = 1 << 10, const Hash& hash = Hash(), Reclaimer& reclaimer = Reclaimer::defaultDomain())
+    : mFirst(nullptr), mTableCount(1), mMinCapacity(2), mSize(), mHash(hash), mReclaimer(reclaimer)
+  {
+    while(mMinCapacity < initialCapacity)
+    {
+      mMinCapacity *= 2;
+    }
+    mFirst.store(new Table(mMinCapacity), std::memory_order_relaxed);
+  }
+  ~LockFreeOpenAddressingHashMap()
+  {
+    auto table = mFirst.load(std::memory_order_relaxed);
+    while(table)
+    {
+      auto next = table->mNext.load(std::memory_order_relaxed);
+      delete table;
+      table = next;
+    }
+  }
+  LockFreeOpenAddressingHashMap(const LockFreeOpenAddressingHashMap&) = delete;
+  LockFreeOpenAddressingHashMap(LockFreeOpenAddressingHashMap&&) = delete;
+  LockFreeOpenAddressingHashMap& operator=(const LockFreeOpenAddressingHashMap&) = delete;
+  LockFreeOpenAddressingHashMap& operator=(LockFreeOpenAddressingHashMap&&) = delete;
+  bool insert(const std::pair<Key, Value>& elem)
+  {
+    assert(elem.first != sEmptyKey && elem.first != sClosedKey);
+    assert(elem.second != sAbsentValue && elem.second != sMovedValue);
+    helpMigrate();
+    bool ans = false;
+    walk([&](Table& table)
+    {
+      ProbeResult result;
+      auto slot = probeOrClaim(table, elem.first, result);
+      if(!slot)
+      {
+        return false;
+      }
+      auto expected = sAbsentValue;
+      if(slot->mValue.compare_exchange_strong(expected, elem.second, std::memory_order_release, std::memory_order_acquire))
+      {
+        ans = true;
+        return true;
+      }
+      // the slot is moved to a newer table which the walk visits next
+      return expected != sMovedValue;
+    });
+    if(ans)
+    {
+      mSize.add(1);
+    }
+    return ans;
+  }
+  // inserts elem, or replaces the value if the key exists. Returns true if elem is inserted.
+  bool insert_or_assign(const std::pair<Key, Value>& elem)
+  {
+    assert(elem.first != sEmptyKey && elem.first != sClosedKey);
+    assert(elem.second != sAbsentValue && elem.second != sMovedValue);
+    helpMigrate();
+    bool ans = false;
+    walk([&](Table& table)
+    {
+      ProbeResult result;
+      auto slot = probeOrClaim(table, elem.first, result);
+      if(!slot)
+      {
+        return false;
+      }
+      auto value = slot->mValue.load(std::memory_order_acquire);
+      while(value != sMovedValue)
+      {
+        if(slot->mValue.compare_exchange_weak(value, elem.second, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+          ans = value == sAbsentValue;
+          return true;
+        }
+      }
+      return false;
+    });
+    if(ans)
+    {
+      mSize.add(1);
+    }
+    return ans;
+  }
+  // the slot keeps the key, it is reused when the key is inserted again until the table is moved.
+  bool remove(Key key)
+  {
+    helpMigrate();
+    bool ans = false;
+    walk([&](Table& table)
+    {
+      auto [result, slot] = probe(table, key, false, false);
+      if(!slot)
+      {
+        return false;
+      }
+      auto value = slot->mValue.load(std::memory_order_acquire);
+      while(value != sMovedValue)
+      {
+        if(value == sAbsentValue)
+        {
+          return true;
+        }
+        if(slot->mValue.compare_exchange_weak(value, sAbsentValue, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+          ans = true;
+          return true;
+        }
+      }
+      return false;
+    });
+    if(ans)
+    {
+      mSize.add(-1);
+    }
+    return ans;
+  }
+  std::optional<Value> find(Key key)
+  {
+    std::optional<Value> ans;
+    walk([&](Table& table)
+    {
+      auto [result, slot] = probe(table, key, false, false);
+      if(!slot)
+      {
+        return false;
+      }
+      auto value = slot->mValue.load(std::memory_order_acquire);
+      if(value == sMovedValue)
+      {
+        return false;
+      }
+      if(value != sAbsentValue)
+      {
+        ans = value;
+      }
+      return true;
+    });
+    return ans;
+  }
+  // weakly consistent iteration, fn(Key, Value) is called for each element.
+  // An element which is moved to a newer table during the iteration may be visited twice.
+  template <typename F>
+  void for_each(F&& fn)
+  {
+    walk([&](Table& table)
+    {
+      for(std::size_t i = 0; i < table.mCapacity; ++i)
+      {
+        auto& slot = table.mSlots[i];
+        auto key = slot.mKey.load(std::memory_order_acquire);
+        if(key == sEmptyKey || key == sClosedKey)
+        {
+          continue;
+        }
+        auto value = slot.mValue.load(std::memory_order_acquire);
+        if(value != sAbsentValue && value != sMovedValue)
+        {
+          fn(key, value);
+        }
+      }
+      return false;
+    });
+  }
+  // the number of chained tables, lookups of absent keys probe all of them. Approximate while other threads modify the map.
+  std::size_t tableCount() const noexcept { return mTableCount.load(std::memory_order_relaxed); }
+  // approximate while other threads modify the map
+  std::size_t size() const noexcept { return mSize.load(); }
+  bool empty() const noexcept { return size() == 0; }
+};
@@ -0,0 +1,412 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "HazardPointer.hpp"
+
+namespace Detail
+{
+struct IntervalRecord
+{
+  // the reservation [mLower, mUpper] of the owner thread, empty (mLower > mUpper) while it is outside of critical sections.
+  std::atomic<std::uint64_t> mLower;
+  std::atomic<std::uint64_t> mUpper;
+  std::atomic<bool> mInUse;
+  IntervalRecord* mNext;
+  IntervalRecord() noexcept
+    : mLower(std::numeric_limits<std::uint64_t>::max()), mUpper(0), mInUse(true), mNext(nullptr) {}
+};
+class IntervalRecordList
+{
+private:
+  std::atomic<IntervalRecord*> mHead;
+public:
+  constexpr IntervalRecordList() noexcept: mHead(nullptr) {}
+  ~IntervalRecordList()
+  {
+    auto cur = mHead.load(std::memory_order_acquire);
+    while(cur)
+    {
+      auto next = cur->mNext;
+      delete cur;
+      cur = next;
+    }
+  }
+  IntervalRecord* acquire()
+  {
+    for(auto cur = mHead.load(std::memory_order_acquire); cur; cur = cur->mNext)
+    {
+      bool expected = false;
+      if(!cur->mInUse.load(std::memory_order_relaxed) &&
+         cur->mInUse.compare_exchange_strong(expected, true, std::memory_order_acquire, std::memory_order_relaxed))
+      {
+        return cur;
+      }
+    }
+    auto node = new IntervalRecord();
+    node->mNext = mHead.load(std::memory_order_relaxed);
+    while(!mHead.compare_exchange_weak(node->mNext, node, std::memory_order_release, std::memory_order_relaxed));
+    return node;
+  }
+  IntervalRecord* getHead() const noexcept
+  {
+    return mHead.load(std::memory_order_acquire);
+  }
+};
+struct RetiredNode
+{
+  void* mData;
+  std::uint64_t mBirthEra;
+  std::uint64_t mRetireEra;
+  std::function<void(void*)> mDeleter;
+};
+struct RetiredBag
+{
+  std::vector<RetiredNode> mNodes;
+  RetiredBag* mNext;
+  explicit RetiredBag(std::vector<RetiredNode>&& nodes) noexcept: mNodes(std::move(nodes)), mNext(nullptr) {}
+  ~RetiredBag()
+  {
+    for(auto& node: mNodes)
+    {
+      node.mDeleter(node.mData);
+    }
+  }
+};
+class RetiredBagList
+{
+private:
+  std::atomic<RetiredBag*> mHead;
+public:
+  constexpr RetiredBagList() noexcept: mHead(nullptr) {}
+  ~RetiredBagList()
+  {
+    auto cur = resetHead();
+    while(cur)
+    {
+      auto next = cur->mNext;
+      delete cur;
+      cur = next;
+    }
+  }
+  void append(RetiredBag* bag) noexcept
+  {
+    bag->mNext = mHead.load(std::memory_order_relaxed);
+    while(!mHead.compare_exchange_weak(bag->mNext, bag, std::memory_order_release, std::memory_order_relaxed));
+  }
+  RetiredBag* resetHead() noexcept
+  {
+    return mHead.exchange(nullptr, std::memory_order_acquire);
+  }
+  RetiredBag* loadHead(std::memory_order order) const noexcept
+  {
+    return mHead.load(order);
+  }
+};
+}
+
+class IntervalGuard;
+
+// Interval based reclamation (2GE-IBR, Wen et al.), a variant of hazard eras (Ramalhete and Correia).
+// Every node records the era it was allocated in, and the era it was retired in when it is retired.
+// A reader reserves the interval of eras [lower, upper] it may have observed: lower is published once on entry,
+// and upper is only republished when the reader sees that the global era has moved, not on every node it visits.
+// A retired node is freed when its lifetime [birth, retire] does not intersect any reservation,
+// so a stalled reader only holds back the nodes which were alive during its reservation and memory stays bounded
+// unlike epoch based reclamation.
+// Nodes must derive from IntervalDomain::NodeBase and are retired through typed pointers, since the birth era is read from the node.
+class IntervalDomain
+{
+private:
+  static constexpr int sEraFrequency = 64;
+  static constexpr std::size_t sReclaimThreshold = 128;
+  class ThreadState
+  {
+  public:
+    Detail::IntervalRecord* mRecord;
+    std::vector<Detail::RetiredNode> mRetiredNodes;
+    std::uint64_t mRetireCount;
+    ThreadState(): mRecord(sIntervalRecordList.acquire()), mRetiredNodes(), mRetireCount(0)
+    {
+      sRecord = mRecord;
+    }
+    ~ThreadState()
+    {
+      // nodes may be still used by other threads, so they are moved to the orphan list instead of being deleted.
+      if(!mRetiredNodes.empty())
+      {
+        sOrphanBagList.append(new Detail::RetiredBag(std::move(mRetiredNodes)));
+      }
+      sRecord = nullptr;
+      mRecord->mUpper.store(0, std::memory_order_release);
+      mRecord->mLower.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_release);
+      mRecord->mInUse.store(false, std::memory_order_release);
+    }
+  };
+  inline static std::atomic<std::uint64_t> sGlobalEra{1};
+  inline static Detail::IntervalRecordList sIntervalRecordList;
+  inline static Detail::RetiredBagList sOrphanBagList;
+  inline static thread_local ThreadState sThreadState;
+  // trivially constructible copies of the hot fields of sThreadState, see also EpochDomain.
+  inline static thread_local Detail::IntervalRecord* sRecord = nullptr;
+  inline static thread_local std::uint64_t sUpper = 0;
+  inline static thread_local unsigned int sNestCount = 0;
+  IntervalDomain() = default;
+  IntervalDomain(const IntervalDomain&) = delete;
+  IntervalDomain(IntervalDomain&&) = delete;
+  IntervalDomain& operator=(const IntervalDomain&) = delete;
+  IntervalDomain& operator=(IntervalDomain&&) = delete;
+  ~IntervalDomain() = default;
+  struct Reservation
+  {
+    std::uint64_t mLower;
+    std::uint64_t mUpper;
+  };
+  static std::vector<Reservation> getReservations()
+  {
+    std::vector<Reservation> ans;
+    for(auto cur = sIntervalRecordList.getHead(); cur; cur = cur->mNext)
+    {
+      // upper is loaded first since the owner stores lower before upper on entry,
+      // an interval torn by a concurrent entry looks empty, which is fine because the owner has not read any pointer yet.
+      auto upper = cur->mUpper.load(std::memory_order_seq_cst);
+      auto lower = cur->mLower.load(std::memory_order_seq_cst);
+      if(lower <= upper)
+      {
+        ans.push_back({lower, upper});
+      }
+    }
+    return ans;
+  }
+  static bool isReserved(const Detail::RetiredNode& node, const std::vector<Reservation>& reservations) noexcept
+  {
+    for(const auto& r: reservations)
+    {
+      if(r.mLower <= node.mRetireEra && node.mBirthEra <= r.mUpper)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+  static void onRetired(ThreadState& state, std::uint64_t num)
+  {
+    // the era is advanced once every sEraFrequency retires of a thread
+    auto prev = state.mRetireCount;
+    state.mRetireCount += num;
+    if(prev / sEraFrequency != state.mRetireCount / sEraFrequency)
+    {
+      sGlobalEra.fetch_add(1, std::memory_order_acq_rel);
+    }
+    if(sReclaimThreshold < state.mRetiredNodes.size())
+    {
+      tryReclaim();
+    }
+  }
+public:
+  using Holder = IntervalGuard;
+  struct NodeBase
+  {
+    std::uint64_t mBirthEra = sGlobalEra.load(std::memory_order_acquire);
+  };
+  static IntervalDomain& defaultDomain() noexcept
+  {
+    static IntervalDomain sDomain;
+    return sDomain;
+  }
+  static void enterCriticalSection()
+  {
+    if(sNestCount++ == 0)
+    {
+      auto record = sRecord ? sRecord : sThreadState.mRecord;
+      auto era = sGlobalEra.load(std::memory_order_seq_cst);
+      record->mLower.store(era, std::memory_order_seq_cst);
+      record->mUpper.store(era, std::memory_order_seq_cst);
+      sUpper = era;
+    }
+  }
+  static void leaveCriticalSection() noexcept
+  {
+    if(--sNestCount == 0)
+    {
+      sRecord->mUpper.store(0, std::memory_order_release);
+      sRecord->mLower.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_release);
+    }
+  }
+  // returns true if the era was unchanged since the last reservation, otherwise extends the reservation and the caller has to reload the pointer.
+  static bool validate() noexcept
+  {
+    auto era = sGlobalEra.load(std::memory_order_seq_cst);
+    if(era == sUpper)
+    {
+      return true;
+    }
+    sRecord->mUpper.store(era, std::memory_order_seq_cst);
+    sUpper = era;
+    return false;
+  }
+  static Holder makeHolder(std::size_t i = 0);
+  template <typename Node, typename Deleter>
+  static void retire(Node* node, Deleter&& deleter)
+  {
+    static_assert(std::is_base_of_v<NodeBase, Node>, "nodes retired to IntervalDomain must derive from IntervalDomain::NodeBase");
+    auto& state = sThreadState;
+    auto birthEra = static_cast<NodeBase*>(node)->mBirthEra;
+    auto retireEra = sGlobalEra.load(std::memory_order_seq_cst);
+    state.mRetiredNodes.push_back({node, birthEra, retireEra, std::function<void(void*)>(std::forward<Deleter>(deleter))});
+    onRetired(state, 1);
+  }
+  // retires the nodes pointed by the iterators in [first, last) with the same deleter, reclamation is tried at most once for the whole range.
+  // None of the nodes is retired if an allocation throws.
+  template <typename InputIterator, typename Deleter>
+  static void retireBatch(InputIterator first, InputIterator last, Deleter&& deleter)
+  {
+    std::function<void(void*)> f(std::forward<Deleter>(deleter));
+    auto& state = sThreadState;
+    auto retireEra = sGlobalEra.load(std::memory_order_seq_cst);
+    auto size = state.mRetiredNodes.size();
+    try
+    {
+      for(; first != last; ++first)
+      {
+        auto node = *first;
+        static_assert(std::is_base_of_v<NodeBase, std::remove_pointer_t<decltype(node)>>, "nodes retired to IntervalDomain must derive from IntervalDomain::NodeBase");
+        state.mRetiredNodes.push_back({node, static_cast<NodeBase*>(node)->mBirthEra, retireEra, f});
+      }
+    }
+    catch(...)
+    {
+      state.mRetiredNodes.erase(state.mRetiredNodes.begin() + size, state.mRetiredNodes.end());
+      throw;
+    }
+    auto num = static_cast<std::uint64_t>(state.mRetiredNodes.size() - size);
+    if(num)
+    {
+      onRetired(state, num);
+    }
+  }
+  static void tryReclaim()
+  {
+    auto& state = sThreadState;
+    // we do not have to collect bags of exited threads right away.
+    // They are taken before the reservations are read, since nodes retired after that may be used by readers which are not in them.
+    auto orphans = sOrphanBagList.loadHead(std::memory_order_relaxed) ? sOrphanBagList.resetHead() : nullptr;
+    // pairs with the seq_cst stores of the reservations, see also HazardPointerDomain::tryDeallocateLocalList
+    Detail::seqCstFence();
+    auto reservations = getReservations();
+    auto& nodes = state.mRetiredNodes;
+    auto it = std::partition(nodes.begin(), nodes.end(), [&reservations](const auto& node){ return isReserved(node, reservations); });
+    std::vector<Detail::RetiredNode> freed(std::make_move_iterator(it), std::make_move_iterator(nodes.end()));
+    nodes.erase(it, nodes.end());
+    for(auto& node: freed)
+    {
+      node.mDeleter(node.mData);
+    }
+    for(auto cur = orphans; cur;)
+    {
+      auto next = cur->mNext;
+      auto& orphanNodes = cur->mNodes;
+      auto orphanIt = std::partition(orphanNodes.begin(), orphanNodes.end(), [&reservations](const auto& node){ return isReserved(node, reservations); });
+      for(auto i = orphanIt; i != orphanNodes.end(); ++i)
+      {
+        i->mDeleter(i->mData);
+      }
+      orphanNodes.erase(orphanIt, orphanNodes.end());
+      if(orphanNodes.empty())
+      {
+        delete cur;
+      }
+      else
+      {
+        sOrphanBagList.append(cur);
+      }
+      cur = next;
+    }
+  }
+};
+
+class IntervalGuard
+{
+private:
+  bool mActive;
+public:
+  IntervalGuard(): mActive(true)
+  {
+    IntervalDomain::enterCriticalSection();
+  }
+  ~IntervalGuard()
+  {
+    if(mActive)
+    {
+      IntervalDomain::leaveCriticalSection();
+    }
+  }
+  IntervalGuard(const IntervalGuard&) = delete;
+  IntervalGuard(IntervalGuard&& other) noexcept: mActive(other.mActive)
+  {
+    other.mActive = false;
+  }
+  IntervalGuard& operator=(const IntervalGuard&) = delete;
+  IntervalGuard& operator=(IntervalGuard&& other) noexcept
+  {
+    IntervalGuard tmp(std::move(other));
+    swap(tmp);
+    return *this;
+  }
+  // the reservation is per thread, so there is nothing to publish per pointer.
+  void store(void*) noexcept {}
+  void release() noexcept {}
+  void swap(IntervalGuard& other) noexcept
+  {
+    using std::swap;
+    swap(mActive, other.mActive);
+  }
+};
+
+inline void swap(IntervalGuard& x, IntervalGuard& y) noexcept
+{
+  x.swap(y);
+}
+
+inline IntervalGuard IntervalDomain::makeHolder(std::size_t)
+{
+  return IntervalGuard();
+}
+
+template <typename T>
+T* claimPointer(std::atomic<T*>& pointer, IntervalGuard&)
+{
+  while(true)
+  {
+    auto p = pointer.load(std::memory_order_seq_cst);
+    if(IntervalDomain::validate())
+    {
+      return p;
+    }
+  }
+}
+
+template <typename MarkablePointer>
+auto claimMarkablePointer(MarkablePointer& markablePointer, IntervalGuard&, bool* mark = nullptr)
+{
+  while(true)
+  {
+    auto [p, m] = markablePointer.load(std::memory_order_seq_cst);
+    if(IntervalDomain::validate())
+    {
+      if(mark)
+      {
+        *mark = m;
+      }
+      return p;
+    }
+  }
+}
@@ -1,173 +1,220 @@
 #pragma once
 
 #include <atomic>
+#include <iterator>
 #include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <iostream>
 #include "HazardPointer.hpp"
+#include "NodePool.hpp"
 
-template<typename T>
+// Michael-Scott queue. The head is a dummy node and every other node holds its element inline,
+// so a push allocates a single node, which can come from the node pool with PoolNodeAllocator.
+// The consumer which moves the head owns the element of the next node, the new dummy, and moves it out while the node is protected.
+// Reclaimer is HazardPointerDomain<2> or any other domain which has the same interface, e.g. EpochDomain.
+template <typename T, typename Reclaimer = HazardPointerDomain<2>, typename NodeAllocator = NewDeleteNodeAllocator>
 class MSQueue
 {
+  // an element is moved out after the head CAS, when the pop can not be undone
+  static_assert(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>);
 private:
   struct Node
   {
-    std::atomic<T*> mData;
     std::atomic<Node*> mNext;
-    Node(): mData(nullptr), mNext(nullptr) {}
+    alignas(T) unsigned char mStorage[sizeof(T)];
+    Node(): mNext(nullptr) {}
+    template <typename... Args>
+    explicit Node(std::in_place_t, Args&&... args): mNext(nullptr) { new(mStorage) T(std::forward<Args>(args)...); }
+    T* get() noexcept { return std::launder(reinterpret_cast<T*>(mStorage)); }
+  };
+  // iterates the nodes of a chain detached by clear, which no other thread modifies
+  class ChainIterator
+  {
+  private:
+    Node* mNode;
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Node*;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Node* const*;
+    using reference = Node* const&;
+    explicit ChainIterator(Node* node) noexcept: mNode(node) {}
+    reference operator*() const noexcept { return mNode; }
+    ChainIterator& operator++() noexcept { mNode = mNode->mNext.load(); return *this; }
+    bool operator==(const ChainIterator& other) const noexcept { return mNode == other.mNode; }
+    bool operator!=(const ChainIterator& other) const noexcept { return mNode != other.mNode; }
   };
   std::atomic<Node*> mHead;
   std::atomic<Node*> mTail;
+  Reclaimer& mReclaimer;
   static void deleteNode(void* node);
+  // unlinks the head and calls consume(T&) with the element of the new head
+  template <typename F>
+  bool popImpl(F&& consume);
 public:
-  MSQueue();
+  explicit MSQueue(Reclaimer& reclaimer = Reclaimer::defaultDomain());
   ~MSQueue();
   MSQueue(const MSQueue&) = delete;
   MSQueue(MSQueue&&) = delete;
   MSQueue& operator=(const MSQueue&) = delete;
   MSQueue& operator=(MSQueue&&) = delete;
-  void push(const T& data);
-  std::unique_ptr<T> tryPop();
+  template <typename... Args>
+  void emplace(Args&&... args);
+  void push(const T& data) { emplace(data); }
+  void push(T&& data) { emplace(std::move(data)); }
+  std::optional<T> tryPop();
+  // moves the head to data, returns false if the queue is empty
+  bool tryPop(T& data);
+  void clear();
 };
 
-template <typename T>
-void MSQueue<T>::deleteNode(void* node)
+template <typename T, typename Reclaimer, typename NodeAllocator>
+void MSQueue<T, Reclaimer, NodeAllocator>::deleteNode(void* node)
 {
-  delete reinterpret_cast<Node*>(node);
+  NodeAllocator::destroy(reinterpret_cast<Node*>(node));
 }
 
-template <typename T>
-MSQueue<T>::MSQueue(): mHead(new Node()), mTail(mHead.load()) {}
+template <typename T, typename Reclaimer, typename NodeAllocator>
+MSQueue<T, Reclaimer, NodeAllocator>::MSQueue(Reclaimer& reclaimer): mHead(NodeAllocator::template create<Node>()), mTail(mHead.load()), mReclaimer(reclaimer) {}
 
-template <typename T>
-MSQueue<T>::~MSQueue()
+template <typename T, typename Reclaimer, typename NodeAllocator>
+MSQueue<T, Reclaimer, NodeAllocator>::~MSQueue()
 {
   auto node = mHead.load();
-  while(node)
+  // the dummy does not hold an element
+  for(bool dummy = true; node; dummy = false)
   {
     auto next = node->mNext.load();
-    delete node->mData.load();
-    delete node;
+    if(!dummy)
+    {
+      node->get()->~T();
+    }
+    NodeAllocator::destroy(node);
     node = next;
   }
 }
 
-template <typename T>
-void MSQueue<T>::push(const T& data)
+template <typename T, typename Reclaimer, typename NodeAllocator>
+template <typename... Args>
+void MSQueue<T, Reclaimer, NodeAllocator>::emplace(Args&&... args)
 {
-  HazardPointerHolder hp(HazardPointerDomain<>::getHazardPointerForCurrentThread());
-  auto p = std::make_unique<T>(data);
-  auto node = std::make_unique<Node>();
+  auto hp = mReclaimer.makeHolder();
+  auto node = makeNode<Node, NodeAllocator>(std::in_place, std::forward<Args>(args)...);
   while(true)
   {
-    Node* tail = nullptr;
-    Node* tmp = nullptr;
-    do
+    Node* tail = claimPointer(mTail, hp);
+    Node* next = tail->mNext.load();
+    if(next)
     {
-      tail = mTail.load(std::memory_order_seq_cst);
-      hp.store(tail);
-      tmp = mTail.load(std::memory_order_seq_cst);
+      // the tail lags behind
+      mTail.compare_exchange_strong(tail, next);
+      continue;
     }
-    while(tail != tmp);
-    T* expected = nullptr;
-    if(tail->mData.compare_exchange_strong(expected, p.get()))
+    Node* expected = nullptr;
+    if(tail->mNext.compare_exchange_strong(expected, node.get()))
     {
-      p.release();
-      Node* expected = nullptr;
-      Node* newNext = node.get();
-      if(tail->mNext.compare_exchange_strong(expected, node.get()))
-      {
-        node.release();
-      }
-      else
-      {
-        newNext = expected;
-      }
-      mTail.compare_exchange_strong(tail, newNext);
-      break;
+      auto newTail = node.release();
+      mTail.compare_exchange_strong(tail, newTail);
+      return;
     }
-    else
+  }
+}
+
+template <typename T, typename Reclaimer, typename NodeAllocator>
+template <typename F>
+bool MSQueue<T, Reclaimer, NodeAllocator>::popImpl(F&& consume)
+{
+  auto hpHead = mReclaimer.makeHolder(0);
+  auto hpNext = mReclaimer.makeHolder(1);
+  while(true)
+  {
+    Node* head = claimPointer(mHead, hpHead);
+    Node* tail = mTail.load(std::memory_order_seq_cst);
+    Node* next = head->mNext.load(std::memory_order_seq_cst);
+    hpNext.store(next);
+    // next is not retired while the protected head is still the head
+    if(head != mHead.load(std::memory_order_seq_cst))
     {
-      Node* expected = nullptr;
-      Node* newNext = node.get();
-      if(tail->mNext.compare_exchange_strong(expected, node.get()))
-      {
-        node.release();
-        node = std::make_unique<Node>();
-      }
-      else
-      {
-        newNext = expected;
-      }
-      mTail.compare_exchange_strong(tail, newNext);
+      continue;
+    }
+    if(!next)
+    {
+      return false;
+    }
+    if(head == tail)
+    {
+      mTail.compare_exchange_strong(tail, next);
+      continue;
+    }
+    if(mHead.compare_exchange_strong(head, next))
+    {
+      hpHead.release();
+      // next is the new dummy, no other consumer touches its element
+      auto elem = next->get();
+      consume(*elem);
+      elem->~T();
+      hpNext.release();
+      mReclaimer.retire(head, &deleteNode);
+      return true;
     }
   }
 }
 
-template <typename T>
-std::unique_ptr<T> MSQueue<T>::tryPop()
+template <typename T, typename Reclaimer, typename NodeAllocator>
+std::optional<T> MSQueue<T, Reclaimer, NodeAllocator>::tryPop()
+{
+  std::optional<T> ans;
+  popImpl([&ans](T& elem) { ans.emplace(std::move(elem)); });
+  return ans;
+}
+
+template <typename T, typename Reclaimer, typename NodeAllocator>
+bool MSQueue<T, Reclaimer, NodeAllocator>::tryPop(T& data)
 {
-  HazardPointerHolder hp(HazardPointerDomain<>::getHazardPointerForCurrentThread());
-  std::unique_ptr<Node> newTail;
+  return popImpl([&data](T& elem) { data = std::move(elem); });
+}
+
+// removes the elements which were pushed before the call.
+// All the nodes between the head and the tail are unlinked with a single CAS and retired as a batch.
+template <typename T, typename Reclaimer, typename NodeAllocator>
+void MSQueue<T, Reclaimer, NodeAllocator>::clear()
+{
+  auto hpHead = mReclaimer.makeHolder(0);
+  auto hpTail = mReclaimer.makeHolder(1);
   while(true)
   {
-    Node* head = nullptr;
-    Node* tmp = nullptr;
-    while(true)
+    Node* head = claimPointer(mHead, hpHead);
+    // the head never overtakes the tail and the protected head can not come back once it is passed,
+    // so if the CAS succeeds, the tail read here is reachable from the head.
+    Node* tail = claimPointer(mTail, hpTail);
+    if(head == tail)
     {
-      head = mHead.load(std::memory_order_seq_cst);
-      hp.store(head);
-      auto tail = mTail.load(std::memory_order_seq_cst);
-      if(head == tail)
-      {
-        hp.store(tail);
-        tmp = mTail.load(std::memory_order_seq_cst);
-        if(tail != tmp)
-        {
-          hp.release();
-          continue;
-        }
-        if(!tail->mData.load())
-        {
-          hp.release();
-          return nullptr;
-        }
-        auto next = tail->mNext.load();
-        if(!next)
-        {
-          if(!newTail)
-          {
-            newTail = std::make_unique<Node>();
-          }
-          Node* expected = nullptr;
-          if(tail->mNext.compare_exchange_strong(expected, newTail.get()))
-          {
-            next = newTail.get();
-            newTail.release();
-          }
-          else
-          {
-            next = tail->mNext.load();
-          }
-        }
-        mTail.compare_exchange_strong(tail, next);
-        hp.release();
-        continue;
-      }
-      tmp = mHead.load(std::memory_order_seq_cst);
-      if(head == tmp)
+      hpHead.release();
+      hpTail.release();
+      // the tail may lag behind, tryPop takes care of it and of the last element
+      if(!tryPop())
       {
-        break;
+        return;
       }
+      continue;
     }
-    auto next = head->mNext.load();
-    if(mHead.compare_exchange_strong(head, next))
+    if(mHead.compare_exchange_strong(head, tail))
     {
-      std::unique_ptr<T> ans(head->mData);
-      hp.release();
-      HazardPointerDomain<>::retire(head, &deleteNode);
-      return ans;
+      hpHead.release();
+      // the elements are in the nodes after the old dummy up to the tail, which is the new dummy.
+      // The tail stays protected since a consumer may retire it as soon as it is the head.
+      for(auto node = head; node != tail; node = node->mNext.load())
+      {
+        node->mNext.load()->get()->~T();
+      }
+      hpTail.release();
+      // the nodes from the old dummy up to, not including, the tail
+      mReclaimer.retireBatch(ChainIterator(head), ChainIterator(tail), &deleteNode);
+      return;
     }
   }
 }
-
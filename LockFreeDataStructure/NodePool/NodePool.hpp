@@ -0,0 +1,269 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace Detail
+{
+struct FreeBlock
+{
+  FreeBlock* mNext;
+};
+struct NodePoolThreadCache;
+struct SlabHeader
+{
+  NodePoolThreadCache* mOwner;
+  SlabHeader* mNext;
+};
+// free blocks and slabs of a thread for a node type.
+// A cache is never deleted because blocks of its slabs may be freed by other threads at any time,
+// it is released when the thread exits and adopted by a thread created later.
+struct NodePoolThreadCache
+{
+  FreeBlock* mLocalFree;
+  std::atomic<FreeBlock*> mRemoteFree; // blocks of the slabs of this cache freed by other threads
+  char* mBumpCur; // unused part of the newest slab
+  char* mBumpEnd;
+  SlabHeader* mSlabs;
+  // blocks freed by this thread which belong to a slab of mPendingOwner, they are returned to the owner as a batch.
+  NodePoolThreadCache* mPendingOwner;
+  FreeBlock* mPendingHead;
+  FreeBlock* mPendingTail;
+  std::size_t mPendingSize;
+  std::atomic<bool> mInUse;
+  NodePoolThreadCache* mNext;
+  NodePoolThreadCache() noexcept
+    : mLocalFree(nullptr), mRemoteFree(nullptr), mBumpCur(nullptr), mBumpEnd(nullptr), mSlabs(nullptr)
+    , mPendingOwner(nullptr), mPendingHead(nullptr), mPendingTail(nullptr), mPendingSize(0), mInUse(true), mNext(nullptr) {}
+  static void pushRemote(NodePoolThreadCache* owner, FreeBlock* head, FreeBlock* tail) noexcept
+  {
+    tail->mNext = owner->mRemoteFree.load(std::memory_order_relaxed);
+    while(!owner->mRemoteFree.compare_exchange_weak(tail->mNext, head, std::memory_order_release, std::memory_order_relaxed));
+  }
+  void flushPending() noexcept
+  {
+    if(mPendingOwner)
+    {
+      pushRemote(mPendingOwner, mPendingHead, mPendingTail);
+      mPendingOwner = nullptr;
+      mPendingHead = mPendingTail = nullptr;
+      mPendingSize = 0;
+    }
+  }
+};
+class NodePoolThreadCacheList
+{
+private:
+  std::atomic<NodePoolThreadCache*> mHead;
+public:
+  constexpr NodePoolThreadCacheList() noexcept: mHead(nullptr) {}
+  // caches and slabs are kept until the process exits, see NodePoolThreadCache
+  ~NodePoolThreadCacheList() = default;
+  NodePoolThreadCache* acquire()
+  {
+    for(auto cur = mHead.load(std::memory_order_acquire); cur; cur = cur->mNext)
+    {
+      bool expected = false;
+      if(!cur->mInUse.load(std::memory_order_relaxed) &&
+         cur->mInUse.compare_exchange_strong(expected, true, std::memory_order_acquire, std::memory_order_relaxed))
+      {
+        return cur;
+      }
+    }
+    auto node = new NodePoolThreadCache();
+    node->mNext = mHead.load(std::memory_order_relaxed);
+    while(!mHead.compare_exchange_weak(node->mNext, node, std::memory_order_release, std::memory_order_relaxed));
+    return node;
+  }
+  static void release(NodePoolThreadCache* cache) noexcept
+  {
+    cache->flushPending();
+    cache->mInUse.store(false, std::memory_order_release);
+  }
+};
+}
+
+// Per thread slab pool for the nodes of type T.
+// A thread allocates from its own free list and slabs, a block freed by the thread which owns its slab goes back to the owner's free list,
+// a block freed by another thread is returned to the owner in batches of sRemoteBatchSize through a lock free list.
+// The owner is found from the address of the block since slabs are aligned to their size.
+// Memory is never returned to the system, the pool only grows to the peak number of nodes.
+template <typename T>
+class NodePool
+{
+private:
+  static constexpr std::size_t sSlabSize = 1 << 16;
+  static constexpr std::size_t sRemoteBatchSize = 64;
+  static constexpr std::size_t sBlockAlign = alignof(T) < alignof(Detail::FreeBlock) ? alignof(Detail::FreeBlock) : alignof(T);
+  static constexpr std::size_t roundUp(std::size_t x, std::size_t align) { return (x + align - 1) / align * align; }
+  static constexpr std::size_t sBlockSize = roundUp(sizeof(T) < sizeof(Detail::FreeBlock) ? sizeof(Detail::FreeBlock) : sizeof(T), sBlockAlign);
+  static constexpr std::size_t sFirstBlockOffset = roundUp(sizeof(Detail::SlabHeader), sBlockAlign);
+  static_assert(sFirstBlockOffset + sBlockSize <= sSlabSize, "node type is too large for NodePool");
+  static_assert(sBlockAlign <= sSlabSize);
+  class ThreadCacheHolder
+  {
+  public:
+    Detail::NodePoolThreadCache* mCache;
+    ThreadCacheHolder(): mCache(sThreadCacheList.acquire())
+    {
+      sCache = mCache;
+    }
+    ~ThreadCacheHolder()
+    {
+      sCache = nullptr;
+      sExited = true;
+      Detail::NodePoolThreadCacheList::release(mCache);
+    }
+  };
+  inline static Detail::NodePoolThreadCacheList sThreadCacheList;
+  inline static thread_local ThreadCacheHolder sThreadCacheHolder;
+  // trivially constructible copies of sThreadCacheHolder, which avoid the initialization check on every access.
+  inline static thread_local Detail::NodePoolThreadCache* sCache = nullptr;
+  inline static thread_local bool sExited = false;
+  static Detail::NodePoolThreadCache* getOwner(void* p) noexcept
+  {
+    auto slab = reinterpret_cast<Detail::SlabHeader*>(reinterpret_cast<std::uintptr_t>(p) & ~static_cast<std::uintptr_t>(sSlabSize - 1));
+    return slab->mOwner;
+  }
+  static void* allocateFrom(Detail::NodePoolThreadCache& cache)
+  {
+    if(!cache.mLocalFree)
+    {
+      // takes all the blocks returned by other threads at once
+      cache.mLocalFree = cache.mRemoteFree.exchange(nullptr, std::memory_order_acquire);
+    }
+    if(auto block = cache.mLocalFree)
+    {
+      cache.mLocalFree = block->mNext;
+      return block;
+    }
+    if(!cache.mBumpCur || static_cast<std::size_t>(cache.mBumpEnd - cache.mBumpCur) < sBlockSize)
+    {
+      auto memory = static_cast<char*>(std::aligned_alloc(sSlabSize, sSlabSize));
+      if(!memory)
+      {
+        throw std::bad_alloc();
+      }
+      auto slab = new(memory) Detail::SlabHeader{&cache, cache.mSlabs};
+      cache.mSlabs = slab;
+      cache.mBumpCur = memory + sFirstBlockOffset;
+      cache.mBumpEnd = memory + sSlabSize;
+    }
+    auto block = cache.mBumpCur;
+    cache.mBumpCur += sBlockSize;
+    return block;
+  }
+public:
+  static void* allocate()
+  {
+    if(sCache)
+    {
+      return allocateFrom(*sCache);
+    }
+    if(!sExited)
+    {
+      return allocateFrom(*sThreadCacheHolder.mCache);
+    }
+    // called from a destructor of another thread local object after the cache of this thread is released
+    auto cache = sThreadCacheList.acquire();
+    auto p = allocateFrom(*cache);
+    Detail::NodePoolThreadCacheList::release(cache);
+    return p;
+  }
+  static void deallocate(void* p) noexcept
+  {
+    auto block = static_cast<Detail::FreeBlock*>(p);
+    auto owner = getOwner(p);
+    auto cache = sCache;
+    if(!cache && !sExited)
+    {
+      cache = sThreadCacheHolder.mCache;
+    }
+    if(cache == owner)
+    {
+      block->mNext = cache->mLocalFree;
+      cache->mLocalFree = block;
+      return;
+    }
+    if(!cache)
+    {
+      // the cache of this thread is already released, the block is returned to the owner right away
+      block->mNext = nullptr;
+      Detail::NodePoolThreadCache::pushRemote(owner, block, block);
+      return;
+    }
+    if(cache->mPendingOwner != owner)
+    {
+      cache->flushPending();
+      cache->mPendingOwner = owner;
+      cache->mPendingTail = block;
+    }
+    block->mNext = cache->mPendingHead;
+    cache->mPendingHead = block;
+    if(sRemoteBatchSize <= ++cache->mPendingSize)
+    {
+      cache->flushPending();
+    }
+  }
+  template <typename... Args>
+  static T* create(Args&&... args)
+  {
+    auto p = allocate();
+    try
+    {
+      return new(p) T(std::forward<Args>(args)...);
+    }
+    catch(...)
+    {
+      deallocate(p);
+      throw;
+    }
+  }
+  static void destroy(T* p) noexcept
+  {
+    if(p)
+    {
+      p->~T();
+      deallocate(p);
+    }
+  }
+};
+
+// NodeAllocator policies of the containers, they create and destroy nodes of any type.
+// The containers use NewDeleteNodeAllocator by default. PoolNodeAllocator is opt in since the pools of all the containers keep
+// their peak memory until the process exits, and up to sRemoteBatchSize - 1 blocks freed by a thread wait for its next remote free or its exit.
+struct PoolNodeAllocator
+{
+  template <typename T, typename... Args>
+  static T* create(Args&&... args) { return NodePool<T>::create(std::forward<Args>(args)...); }
+  template <typename T>
+  static void destroy(T* p) noexcept { NodePool<T>::destroy(p); }
+};
+
+struct NewDeleteNodeAllocator
+{
+  template <typename T, typename... Args>
+  static T* create(Args&&... args) { return new T(std::forward<Args>(args)...); }
+  template <typename T>
+  static void destroy(T* p) noexcept { delete p; }
+};
+
+template <typename NodeAllocator>
+struct NodeDeleter
+{
+  template <typename T>
+  void operator()(T* p) const noexcept { NodeAllocator::destroy(p); }
+};
+
+template <typename T, typename NodeAllocator>
+using NodePtr = std::unique_ptr<T, NodeDeleter<NodeAllocator>>;
+
+template <typename T, typename NodeAllocator, typename... Args>
+NodePtr<T, NodeAllocator> makeNode(Args&&... args)
+{
+  return NodePtr<T, NodeAllocator>(NodeAllocator::template create<T>(std::forward<Args>(args)...));
+}
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include "HazardPointer.hpp"
+#include "EpochBasedReclamation.hpp"
+
+class QuiescentStateGuard;
+
+// Quiescent state based reclamation (McKenney and Slingwine).
+// A registered thread is always online and reads without any per access cost,
+// it announces a quiescent state, a point where it holds no reference to shared nodes, by quiescentState().
+// Nodes are freed once every online thread has announced a quiescent state after they were retired.
+// Threads which are not registered go online only while they hold a guard, which costs as much as EpochDomain.
+// A registered thread which does not announce quiescent states blocks all reclamation.
+// All the state is process wide, defaultDomain() only exists to have the same interface as HazardPointerDomain.
+class QuiescentStateDomain
+{
+private:
+  static constexpr int sReclaimThreshold = 128;
+  class ThreadState
+  {
+  public:
+    Detail::EpochRecord* mRecord; // mEpoch is (epoch << 1) | 1 while the thread is online, 0 otherwise.
+    Detail::DeleteListNode* mCurrent; // nodes retired after the last seal
+    int mCurrentSize;
+    Detail::LimboBag* mSealedBags;
+    ThreadState(): mRecord(sEpochRecordList.acquire()), mCurrent(nullptr), mCurrentSize(0), mSealedBags(nullptr)
+    {
+      sRecord = mRecord;
+    }
+    ~ThreadState()
+    {
+      // nodes may be still used by other threads, so they are moved to the orphan list instead of being deleted.
+      if(mCurrent)
+      {
+        sOrphanBagList.append(new Detail::LimboBag(mCurrent, sGlobalEpoch.fetch_add(1, std::memory_order_acq_rel) + 1));
+      }
+      while(mSealedBags)
+      {
+        auto next = mSealedBags->mNext;
+        sOrphanBagList.append(mSealedBags);
+        mSealedBags = next;
+      }
+      sRecord = nullptr;
+      sRegistered = false;
+      mRecord->mEpoch.store(0, std::memory_order_release);
+      mRecord->mInUse.store(false, std::memory_order_release);
+    }
+  };
+  inline static std::atomic<std::uint64_t> sGlobalEpoch{0};
+  inline static Detail::EpochRecordList sEpochRecordList;
+  inline static Detail::OrphanBagList sOrphanBagList;
+  inline static thread_local ThreadState sThreadState;
+  // trivially constructible copies of the hot fields of sThreadState, see also EpochDomain.
+  inline static thread_local Detail::EpochRecord* sRecord = nullptr;
+  inline static thread_local bool sRegistered = false;
+  inline static thread_local unsigned int sNestCount = 0;
+  QuiescentStateDomain() = default;
+  QuiescentStateDomain(const QuiescentStateDomain&) = delete;
+  QuiescentStateDomain(QuiescentStateDomain&&) = delete;
+  QuiescentStateDomain& operator=(const QuiescentStateDomain&) = delete;
+  QuiescentStateDomain& operator=(QuiescentStateDomain&&) = delete;
+  ~QuiescentStateDomain() = default;
+  static Detail::EpochRecord* getRecord()
+  {
+    return sRecord ? sRecord : sThreadState.mRecord;
+  }
+  static void goOnline()
+  {
+    auto epoch = sGlobalEpoch.load(std::memory_order_acquire);
+    getRecord()->mEpoch.store((epoch << 1) | 1, std::memory_order_release);
+    // pairs with the fence in tryReclaim, the thread must not read shared nodes before the reclaimer can see that it is online.
+    Detail::seqCstFence();
+  }
+  static void goOffline() noexcept
+  {
+    sRecord->mEpoch.store(0, std::memory_order_release);
+  }
+  // the oldest epoch announced by online threads, nodes sealed at this epoch or before are not referred by any thread.
+  static std::uint64_t getSafeEpoch() noexcept
+  {
+    auto ans = std::numeric_limits<std::uint64_t>::max();
+    for(auto cur = sEpochRecordList.getHead(); cur; cur = cur->mNext)
+    {
+      // acquire pairs with the release stores of the owner thread so that its reads before the quiescent state happen before the reclamation.
+      auto e = cur->mEpoch.load(std::memory_order_acquire);
+      if((e & 1) && (e >> 1) < ans)
+      {
+        ans = e >> 1;
+      }
+    }
+    return ans;
+  }
+public:
+  using Holder = QuiescentStateGuard;
+  // nodes do not need any per node state for this domain, see also IntervalDomain::NodeBase.
+  struct NodeBase {};
+  static QuiescentStateDomain& defaultDomain() noexcept
+  {
+    static QuiescentStateDomain sDomain;
+    return sDomain;
+  }
+  // a registered thread has to call quiescentState() regularly until it calls unregisterThread().
+  static void registerThread()
+  {
+    if(!sRegistered && sNestCount == 0)
+    {
+      goOnline();
+    }
+    sRegistered = true;
+  }
+  static void unregisterThread() noexcept
+  {
+    if(sRegistered && sNestCount == 0)
+    {
+      goOffline();
+    }
+    sRegistered = false;
+  }
+  static bool isRegistered() noexcept
+  {
+    return sRegistered;
+  }
+  // the caller must not hold any reference to nodes of structures using this domain.
+  static void quiescentState() noexcept
+  {
+    if(sRegistered)
+    {
+      // release orders the reads of the previous operations before the announcement
+      sRecord->mEpoch.store((sGlobalEpoch.load(std::memory_order_acquire) << 1) | 1, std::memory_order_release);
+    }
+  }
+  static void enterCriticalSection()
+  {
+    if(sNestCount++ == 0 && !sRegistered)
+    {
+      goOnline();
+    }
+  }
+  static void leaveCriticalSection() noexcept
+  {
+    if(--sNestCount == 0 && !sRegistered)
+    {
+      goOffline();
+    }
+  }
+  static Holder makeHolder(std::size_t i = 0);
+  template <typename Deleter>
+  static void retire(void* data, Deleter&& deleter)
+  {
+    auto node = std::make_unique<Detail::DeleteListNode>(data, std::forward<Deleter>(deleter));
+    auto& state = sThreadState;
+    node->mNext = state.mCurrent;
+    state.mCurrent = node.release();
+    if(sReclaimThreshold < ++state.mCurrentSize)
+    {
+      tryReclaim();
+    }
+  }
+  // retires the nodes pointed by the iterators in [first, last) with the same deleter, reclamation is tried at most once for the whole range.
+  // None of the nodes is retired if an allocation throws.
+  template <typename InputIterator, typename Deleter>
+  static void retireBatch(InputIterator first, InputIterator last, Deleter&& deleter)
+  {
+    if(first == last)
+    {
+      return;
+    }
+    std::function<void(void*)> f(std::forward<Deleter>(deleter));
+    auto& state = sThreadState;
+    auto chain = Detail::makeDeleteListChain(first, last, f);
+    chain.mTail->mNext = state.mCurrent;
+    state.mCurrent = chain.mHead;
+    state.mCurrentSize += chain.mSize;
+    if(sReclaimThreshold < state.mCurrentSize)
+    {
+      tryReclaim();
+    }
+  }
+  static void tryReclaim()
+  {
+    auto& state = sThreadState;
+    if(state.mCurrent)
+    {
+      // the nodes retired so far are unlinked before the new epoch, a thread which announces the new epoch or later does not refer them.
+      auto epoch = sGlobalEpoch.fetch_add(1, std::memory_order_acq_rel) + 1;
+      auto bag = new Detail::LimboBag(state.mCurrent, epoch);
+      bag->mNext = state.mSealedBags;
+      state.mSealedBags = bag;
+      state.mCurrent = nullptr;
+      state.mCurrentSize = 0;
+    }
+    // pairs with the fence in goOnline
+    Detail::seqCstFence();
+    auto safeEpoch = getSafeEpoch();
+    // bags are sorted from the newest one
+    for(auto prev = &state.mSealedBags; *prev; prev = &(*prev)->mNext)
+    {
+      if((*prev)->mEpoch <= safeEpoch)
+      {
+        auto cur = *prev;
+        *prev = nullptr;
+        while(cur)
+        {
+          auto next = cur->mNext;
+          delete cur;
+          cur = next;
+        }
+        break;
+      }
+    }
+    // we do not have to collect bags of exited threads right away.
+    if(sOrphanBagList.loadHead(std::memory_order_relaxed))
+    {
+      auto cur = sOrphanBagList.resetHead();
+      while(cur)
+      {
+        auto next = cur->mNext;
+        if(cur->mEpoch <= safeEpoch)
+        {
+          delete cur;
+        }
+        else
+        {
+          sOrphanBagList.append(cur);
+        }
+        cur = next;
+      }
+    }
+  }
+};
+
+class QuiescentStateGuard
+{
+private:
+  bool mActive;
+public:
+  QuiescentStateGuard(): mActive(true)
+  {
+    QuiescentStateDomain::enterCriticalSection();
+  }
+  ~QuiescentStateGuard()
+  {
+    if(mActive)
+    {
+      QuiescentStateDomain::leaveCriticalSection();
+    }
+  }
+  QuiescentStateGuard(const QuiescentStateGuard&) = delete;
+  QuiescentStateGuard(QuiescentStateGuard&& other) noexcept: mActive(other.mActive)
+  {
+    other.mActive = false;
+  }
+  QuiescentStateGuard& operator=(const QuiescentStateGuard&) = delete;
+  QuiescentStateGuard& operator=(QuiescentStateGuard&& other) noexcept
+  {
+    QuiescentStateGuard tmp(std::move(other));
+    swap(tmp);
+    return *this;
+  }
+  // nodes are protected until the next quiescent state, so there is nothing to publish per pointer.
+  void store(void*) noexcept {}
+  void release() noexcept {}
+  void swap(QuiescentStateGuard& other) noexcept
+  {
+    using std::swap;
+    swap(mActive, other.mActive);
+  }
+};
+
+inline void swap(QuiescentStateGuard& x, QuiescentStateGuard& y) noexcept
+{
+  x.swap(y);
+}
+
+inline QuiescentStateGuard QuiescentStateDomain::makeHolder(std::size_t)
+{
+  return QuiescentStateGuard();
+}
+
+template <typename T>
+T* claimPointer(std::atomic<T*>& pointer, QuiescentStateGuard&)
+{
+  return pointer.load(std::memory_order_acquire);
+}
+
+template <typename MarkablePointer>
+auto claimMarkablePointer(MarkablePointer& markablePointer, QuiescentStateGuard&, bool* mark = nullptr)
+{
+  auto [p, m] = markablePointer.load(std::memory_order_acquire);
+  if(mark)
+  {
+    *mark = m;
+  }
+  return p;
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "HazardPointer.hpp"
+
+// Unbounded multi producer multi consumer queue on a linked list of array segments (P. Ramalhete and A. Correia, FAAArrayQueue).
+// Producers and consumers claim cells of the tail and the head segment with a fetch_add on the index of the segment instead of a CAS on a shared pointer,
+// so contended operations do not retry, and a CAS is only needed to move to the next segment once per SegmentSize elements.
+// A consumer which claims a cell before its producer marks the cell as taken and the producer claims another cell.
+// Elements are stored inline in the cells and a drained segment is retired to the reclaimer.
+// Like BoundedMPMCQueue the queue is not lock-free in the strict sense:
+// a consumer waits for a producer which is preempted between claiming a cell and moving the element in.
+// Reclaimer is HazardPointerDomain<1> or any other domain which has the same interface, e.g. EpochDomain.
+template <typename T, std::size_t SegmentSize = 1024, typename Reclaimer = HazardPointerDomain<>>
+class SegmentedQueue
+{
+  // an element is moved in and out of a claimed cell, which can not be given back if the move throws
+  static_assert(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>);
+  static_assert(0 < SegmentSize);
+private:
+  static constexpr std::size_t sCacheLineSize = 64;
+  // blocking waits spin this many times before they yield the processor
+  static constexpr int sSpinCount = 64;
+  enum CellState: int { Empty, Writing, Ready, Taken };
+  struct Cell
+  {
+    std::atomic<int> mState;
+    alignas(T) unsigned char mStorage[sizeof(T)];
+    Cell(): mState(Empty) {}
+    T* get() noexcept { return std::launder(reinterpret_cast<T*>(mStorage)); }
+  };
+  struct Segment
+  {
+    alignas(sCacheLineSize) std::atomic<std::size_t> mDequeueIndex;
+    alignas(sCacheLineSize) std::atomic<std::size_t> mEnqueueIndex;
+    alignas(sCacheLineSize) std::atomic<Segment*> mNext;
+    Cell mCells[SegmentSize];
+    Segment(): mDequeueIndex(0), mEnqueueIndex(0), mNext(nullptr) {}
+    ~Segment()
+    {
+      // the elements which were pushed and not popped
+      for(auto& cell: mCells)
+      {
+        if(cell.mState.load(std::memory_order_relaxed) == Ready)
+        {
+          cell.get()->~T();
+        }
+      }
+    }
+  };
+  alignas(sCacheLineSize) std::atomic<Segment*> mHead;
+  alignas(sCacheLineSize) std::atomic<Segment*> mTail;
+  Reclaimer& mReclaimer;
+  static void deleteSegment(void* segment);
+  static void backoff(int& spin) noexcept
+  {
+    if(++spin < sSpinCount)
+    {
+      return;
+    }
+    spin = 0;
+    std::this_thread::yield();
+  }
+  template <typename... Args>
+  void emplaceImpl(Args&&... args);
+  // claims the head cell and calls consume(T&) with its element
+  template <typename F>
+  bool popImpl(F&& consume);
+public:
+  explicit SegmentedQueue(Reclaimer& reclaimer = Reclaimer::defaultDomain());
+  ~SegmentedQueue();
+  SegmentedQueue(const SegmentedQueue&) = delete;
+  SegmentedQueue& operator=(const SegmentedQueue&) = delete;
+  template <typename... Args>
+  void emplace(Args&&... args)
+  {
+    if constexpr(std::is_nothrow_constructible_v<T, Args&&...>)
+    {
+      emplaceImpl(std::forward<Args>(args)...);
+    }
+    else
+    {
+      // the element is constructed before a cell is claimed, so that a throwing constructor leaves the queue as it was
+      emplaceImpl(T(std::forward<Args>(args)...));
+    }
+  }
+  void push(const T& data) { emplace(data); }
+  void push(T&& data) { emplace(std::move(data)); }
+  std::optional<T> tryPop();
+  // moves the head to data, returns false if the queue is empty
+  bool tryPop(T& data);
+  // approximate while other threads use the queue
+  bool empty() const;
+};
+
+template <typename T, std::size_t SegmentSize, typename Reclaimer>
+void SegmentedQueue<T, SegmentSize, Reclaimer>::deleteSegment(void* segment)
+{
+  delete reinterpret_cast<Segment*>(segment);
+}
+
+template <typename T, std::size_t SegmentSize, typename Reclaimer>
+SegmentedQueue<T, SegmentSize, Reclaimer>::SegmentedQueue(Reclaimer& reclaimer): mHead(new Segment()), mTail(mHead.load()), mReclaimer(reclaimer) {}
+
+template <typename T, std::size_t SegmentSize, typename Reclaimer>
+SegmentedQueue<T, SegmentSize, Reclaimer>::~SegmentedQueue()
+{
+  auto segment = mHead.load();
+  while(segment)
+  {
+    auto next = segment->mNext.load();
+    delete segment;
+    segment = next;
+  }
+}
+
+template <typename T, std::size_t SegmentSize, typename Reclaimer>
+template <typename... Args>
+void SegmentedQueue<T, SegmentSize, Reclaimer>::emplaceImpl(Args&&... args)
+{
+  auto hp = mReclaimer.makeHolder();
+  // a segment which lost the race to be linked is kept for the next full segment
+  std::unique_ptr<Segment> newSegment;
+  while(true)
+  {
+    Segment* tail = claimPointer(mTail, hp);
+    auto index = tail->mEnqueueIndex.fetch_add(1);
+    if(index < SegmentSize)
+    {
+      auto& cell = tail->mCells[index];
+      int expected = Empty;
+      if(cell.mState.compare_exchange_strong(expected, Writing, std::memory_order_relaxed, std::memory_order_relaxed))
+      {
+        new(cell.mStorage) T(std::forward<Args>(args)...);
+        cell.mState.store(Ready, std::memory_order_release);
+        return;
+      }
+      // a consumer has given up on the cell
+      continue;
+    }
+    // the segment is full, the first producer which gets here links a new one
+    Segment* next = tail->mNext.load();
+    if(!next)
+    {
+      if(!newSegment)
+      {
+        newSegment = std::make_unique<Segment>();
+      }
+      if(tail->mNext.compare_exchange_strong(next, newSegment.get()))
+      {
+        next = newSegment.release();
+      }
+    }
+    mTail.compare_exchange_strong(tail, next);
+  }
+}
+
+template <typename T, std::size_t SegmentSize, typename Reclaimer>
+template <typename F>
+bool SegmentedQueue<T, SegmentSize, Reclaimer>::popImpl(F&& consume)
+{
+  auto hp = mReclaimer.makeHolder();
+  while(true)
+  {
+    Segment* head = claimPointer(mHead, hp);
+    // do not claim cells which no producer has claimed, they would only make the producers retry
+    if(head->mEnqueueIndex.load() <= head->mDequeueIndex.load() && !head->mNext.load())
+    {
+      return false;
+    }
+    auto index = head->mDequeueIndex.fetch_add(1);
+    if(index < SegmentSize)
+    {
+      auto& cell = head->mCells[index];
+      int state = Empty;
+      if(cell.mState.compare_exchange_strong(state, Taken, std::memory_order_acquire, std::memory_order_acquire))
+      {
+        // the producer of the cell has not come yet and will claim another cell
+        continue;
+      }
+      for(int spin = 0; state == Writing; state = cell.mState.load(std::memory_order_acquire))
+      {
+        backoff(spin);
+      }
+      auto elem = cell.get();
+      consume(*elem);
+      elem->~T();
+      // only the consumer which claimed the index touches the cell, the state is read by the destructor of the segment
+      cell.mState.store(Taken, std::memory_order_relaxed);
+      return true;
+    }
+    // the segment is drained, any producer which has not come yet goes to the next segment
+    Segment* next = head->mNext.load();
+    if(!next)
+    {
+      return false;
+    }
+    // the tail has to be moved first, otherwise producers could claim the retired segment from the tail
+    Segment* tail = head;
+    mTail.compare_exchange_strong(tail, next);
+    if(mHead.compare_exchange_strong(head, next))
+    {
+      hp.release();
+      mReclaimer.retire(head, &deleteSegment);
+    }
+  }
+}
+
+template <typename T, std::size_t SegmentSize, typename Reclaimer>
+std::optional<T> SegmentedQueue<T, SegmentSize, Reclaimer>::tryPop()
+{
+  std::optional<T> ans;
+  popImpl([&ans](T& elem) { ans.emplace(std::move(elem)); });
+  return ans;
+}
+
+template <typename T, std::size_t SegmentSize, typename Reclaimer>
+bool SegmentedQueue<T, SegmentSize, Reclaimer>::tryPop(T& data)
+{
+  return popImpl([&data](T& elem) { data = std::move(elem); });
+}
+
+template <typename T, std::size_t SegmentSize, typename Reclaimer>
+bool SegmentedQueue<T, SegmentSize, Reclaimer>::empty() const
+{
+  auto hp = mReclaimer.makeHolder();
+  auto head = claimPointer(const_cast<std::atomic<Segment*>&>(mHead), hp);
+  return head->mEnqueueIndex.load() <= head->mDequeueIndex.load() && !head->mNext.load();
+}
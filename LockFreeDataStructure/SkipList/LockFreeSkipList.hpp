@@ -0,0 +1,401 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include "AtomicMarkablePointer.hpp"
+#include "HazardPointer.hpp"
+#include "NodePool.hpp"
+#include "ShardedCounter.hpp"
+
+// Ordered map on a lock-free skip list (Herlihy and Shavit, The Art of Multiprocessor Programming 14.4).
+// A node is removed by marking its next pointers from the top level down, the mark of level 0 decides which thread removed it.
+// Marked nodes are unlinked by any search which passes them, so find and lower_bound are lock-free but not wait-free:
+// a search can not step over a marked node without knowing that its successor is still alive, it unlinks the node or restarts instead.
+// Elements are immutable once inserted, an update is remove and insert.
+// A node is retired after both its insert and its remove are done, each of them holds a reference to the node,
+// since the inserter may link the upper levels of a node after a remover has unlinked it.
+// Reclaimer is HazardPointerDomain<6> or any other domain which has the same interface, e.g. EpochDomain.
+// Searches use the hazard pointers 0 to 2, insert and remove keep their node in 3 and iterators use 4 and 5.
+template <typename Key, typename Value, typename Compare = std::less<Key>, typename Reclaimer = HazardPointerDomain<6>,
+          typename NodeAllocator = NewDeleteNodeAllocator>
+class LockFreeSkipList
+{
+private:
+  using Holder = typename Reclaimer::Holder;
+  static constexpr int sMaxHeight = 16;
+  // the head has sMaxHeight levels and no key, the end of every level is nullptr
+  struct Node: Reclaimer::NodeBase
+  {
+    int mHeight;
+    std::atomic<int> mReferences;
+    std::unique_ptr<AtomicMarkablePointer<Node>[]> mNext;
+    explicit Node(int height): mHeight(height), mReferences(2), mNext(new AtomicMarkablePointer<Node>[height])
+    {
+      for(int i = 0; i < height; ++i)
+      {
+        mNext[i].store(nullptr, false, std::memory_order_relaxed);
+      }
+    }
+  };
+  struct ValueNode: Node
+  {
+    std::pair<const Key, Value> mValue;
+    ValueNode(int height, const Key& key, const Value& value): Node(height), mValue(key, value) {}
+  };
+  Node* mHead;
+  std::atomic<int> mHeight; // the highest level in use, searches start from it
+  ShardedCounter mSize;
+  Reclaimer& mReclaimer;
+  Compare mCompare; // TODO: EBO
+  static void deleter(void* data)
+  {
+    NodeAllocator::destroy(static_cast<ValueNode*>(data));
+  }
+  // a level is kept with probability 1/4, which needs fewer pointers per node than 1/2 for the same search cost
+  static int randomHeight() noexcept
+  {
+    static thread_local std::uint64_t sState = std::hash<std::thread::id>()(std::this_thread::get_id()) * 0x9E3779B97F4A7C15ULL + 1;
+    sState ^= sState << 13;
+    sState ^= sState >> 7;
+    sState ^= sState << 17;
+    int height = 1;
+    for(auto r = sState; height < sMaxHeight && (r & 3) == 0; r >>= 2)
+    {
+      ++height;
+    }
+    return height;
+  }
+  bool equals(const ValueNode* node, const Key& key) const
+  {
+    return node && !mCompare(key, node->mValue.first) && !mCompare(node->mValue.first, key);
+  }
+  // searches the levels from the top down to level and returns pred and cur at level,
+  // where cur is the first node whose key is not less than key, or greater than key if after is true, and nullptr at the end.
+  // Marked nodes on the way are unlinked, cur was not marked when it was visited.
+  std::tuple<Node*, ValueNode*, Holder, Holder> search(const Key& key, int level, bool after = false);
+  void linkUpperLevels(ValueNode* node);
+  // drops a reference of the inserter or the remover, the last one retires the node
+  void release(ValueNode* node)
+  {
+    if(node->mReferences.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      mReclaimer.retire(node, &deleter);
+    }
+  }
+public:
+  // Iterates the elements in key order. An element which stays in the map during the iteration is visited once,
+  // elements inserted or removed concurrently may or may not be visited.
+  // An iterator keeps its element protected by the hazard pointers 4 and 5 of the thread, so a thread can use one iterator of a domain at a time.
+  // With EpochDomain an iterator stays in a critical section, which delays the reclamation of every thread until it is destructed.
+  class Iterator
+  {
+  private:
+    friend class LockFreeSkipList;
+    LockFreeSkipList* mMap;
+    ValueNode* mNode;
+    std::optional<Holder> mHolder;
+    std::optional<Holder> mNextHolder;
+    Iterator(LockFreeSkipList* map, ValueNode* node): mMap(map), mNode(node) {}
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::pair<const Key, Value>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+    Iterator(Iterator&&) = default;
+    // both iterators use the same hazard pointers of the thread, so releasing the old ones also clears the protection of the new element,
+    // which is stored again after the holders are taken over.
+    Iterator& operator=(Iterator&& other) noexcept
+    {
+      if(this != &other)
+      {
+        mHolder.reset();
+        mNextHolder.reset();
+        mMap = other.mMap;
+        mNode = other.mNode;
+        mHolder = std::move(other.mHolder);
+        mNextHolder = std::move(other.mNextHolder);
+        if(mHolder && mNode)
+        {
+          mHolder->store(mNode);
+        }
+      }
+      return *this;
+    }
+    reference operator*() const noexcept { return mNode->mValue; }
+    pointer operator->() const noexcept { return &mNode->mValue; }
+    Iterator& operator++();
+    bool operator==(const Iterator& other) const noexcept { return mNode == other.mNode; }
+    bool operator!=(const Iterator& other) const noexcept { return mNode != other.mNode; }
+  };
+  explicit LockFreeSkipList(const Compare& compare = Compare(), Reclaimer& reclaimer = Reclaimer::defaultDomain());
+  ~LockFreeSkipList();
+  LockFreeSkipList(const LockFreeSkipList&) = delete;
+  LockFreeSkipList& operator=(const LockFreeSkipList&) = delete;
+  // returns false if key is already in the map
+  bool insert(const Key& key, const Value& value);
+  bool remove(const Key& key);
+  std::optional<Value> find(const Key& key);
+  bool contains(const Key& key);
+  // the first element whose key is not less than key, a range [k1, k2) is scanned from lower_bound(k1) while the key is less than k2
+  Iterator lower_bound(const Key& key);
+  Iterator begin();
+  Iterator end() noexcept { return Iterator(this, nullptr); }
+  // approximate while other threads modify the map
+  std::size_t size() const noexcept { return static_cast<std::size_t>(std::max<std::int64_t>(mSize.load(), 0)); }
+  bool empty() const noexcept { return size() == 0; }
+};
+
+template <typename Key, typename Value, typename Compare, typename Reclaimer, typename NodeAllocator>
+LockFreeSkipList<Key, Value, Compare, Reclaimer, NodeAllocator>::LockFreeSkipList(const Compare& compare, Reclaimer& reclaimer)
+  : mHead(NodeAllocator::template create<Node>(sMaxHeight))
+  , mHeight(1)
+  , mSize()
+  , mReclaimer(reclaimer)
+  , mCompare(compare)
+{
+}
+template <typename Key, typename Value, typename Compare, typename Reclaimer, typename NodeAllocator>
+LockFreeSkipList<Key, Value, Compare, Reclaimer, NodeAllocator>::~LockFreeSkipList()
+{
+  // every removed node has been unlinked from all levels, the rest is linked at level 0
+  auto cur = mHead->mNext[0].load(std::memory_order_acquire).first;
+  while(cur)
+  {
+    auto next = cur->mNext[0].load(std::memory_order_relaxed).first;
+    NodeAllocator::destroy(static_cast<ValueNode*>(cur));
+    cur = next;
+  }
+  NodeAllocator::destroy(mHead);
+}
+template <typename Key, typename Value, typename Compare, typename Reclaimer, typename NodeAllocator>
+auto LockFreeSkipList<Key, Value, Compare, Reclaimer, NodeAllocator>::search(const Key& key, int level, bool after)
+  -> std::tuple<Node*, ValueNode*, Holder, Holder>
+{
+  using std::swap;
+  auto predHpHolder = mReclaimer.makeHolder(0);
+  auto curHpHolder = mReclaimer.makeHolder(1);
+  auto succHpHolder = mReclaimer.makeHolder(2);
+  auto before = [this, &key, after](const Node* node) {
+    auto& nodeKey = static_cast<const ValueNode*>(node)->mValue.first;
+    return after ? !mCompare(key, nodeKey) : mCompare(nodeKey, key);
+  };
+  while(true)
+  {
+    bool retry = false;
+    // the head is never removed, so it does not have to be protected
+    Node* pred = mHead;
+    Node* cur = nullptr;
+    for(int l = std::max(mHeight.load(std::memory_order_relaxed), level + 1) - 1; level <= l; --l)
+    {
+      bool mark;
+      cur = claimMarkablePointer(pred->mNext[l], curHpHolder, &mark);
+      if(mark)
+      {
+        // pred has been removed since the level above, cur may not be alive
+        retry = true;
+        break;
+      }
+      while(cur)
+      {
+        auto* succ = claimMarkablePointer(cur->mNext[l], succHpHolder, &mark);
+        if(mark)
+        {
+          bool expectedMark = false;
+          if(!pred->mNext[l].compare_exchange_strong(cur, succ, expectedMark, false, std::memory_order_release, std::memory_order_relaxed))
+          {
+            retry = true;
+            break;
+          }
+          cur = succ;
+          swap(curHpHolder, succHpHolder);
+          continue;
+        }
+        if(!before(cur))
+        {
+          break;
+        }
+        pred = cur;
+        swap(predHpHolder, curHpHolder);
+        cur = succ;
+        swap(curHpHolder, succHpHolder);
+      }
+      if(retry)
+      {
+        break;
+      }
+    }
+    if(!retry)
+    {
+      return {pred, static_cast<ValueNode*>(cur), std::move(predHpHolder), std::move(curHpHolder)};
+    }
+  }
+}
+template <typename Key, typename Value, typename Compare, typename Reclaimer, typename NodeAllocator>
+void LockFreeSkipList<Key, Value, Compare, Reclaimer, NodeAllocator>::linkUpperLevels(ValueNode* node)
+{
+  auto& key = node->mValue.first;
+  for(int level = 1; level < node->mHeight; ++level)
+  {
+    while(true)
+    {
+      auto [pred, succ, predHpHolder, succHpHolder] = search(key, level);
+      auto [next, mark] = node->mNext[level].load(std::memory_order_acquire);
+      // a remover marks every level before level 0, the node is not linked any further once it is marked
+      if(mark || !node->mNext[level].compare_exchange_strong(next, succ, mark, false, std::memory_order_relaxed, std::memory_order_relaxed))
+      {
+        return;
+      }
+      bool expectedMark = false;
+      Node* expected = succ;
+      if(pred->mNext[level].compare_exchange_strong(expected, node, expectedMark, false, std::memory_order_release, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+  }
+}
+template <typename Key, typename Value, typename Compare, typename Reclaimer, typename NodeAllocator>
+bool LockFreeSkipList<Key, Value, Compare, Reclaimer, NodeAllocator>::insert(const Key& key, const Value& value)
+{
+  auto height = randomHeight();
+  auto newNode = makeNode<ValueNode, NodeAllocator>(height, key, value);
+  while(true)
+  {
+    auto [pred, cur, predHpHolder, curHpHolder] = search(key, 0);
+    if(equals(cur, key))
+    {
+      return false;
+    }
+    newNode->mNext[0].store(cur, false, std::memory_order_relaxed);
+    bool expectedMark = false;
+    Node* expected = cur;
+    if(pred->mNext[0].compare_exchange_strong(expected, newNode.get(), expectedMark, false, std::memory_order_release, std::memory_order_relaxed))
+    {
+      break;
+    }
+  }
+  // the reference of the inserter keeps the node alive until the upper levels are linked
+  auto node = newNode.release();
+  mSize.add(1);
+  for(auto h = mHeight.load(std::memory_order_relaxed); h < height && !mHeight.compare_exchange_weak(h, height, std::memory_order_relaxed););
+  linkUpperLevels(node);
+  if(node->mNext[0].load(std::memory_order_acquire).second)
+  {
+    // the node has been removed meanwhile and the remover may have missed the levels linked after its search
+    search(key, 0);
+  }
+  release(node);
+  return true;
+}
+template <typename Key, typename Value, typename Compare, typename Reclaimer, typename NodeAllocator>
+bool LockFreeSkipList<Key, Value, Compare, Reclaimer, NodeAllocator>::remove(const Key& key)
+{
+  auto nodeHpHolder = mReclaimer.makeHolder(3);
+  ValueNode* node;
+  {
+    auto [pred, cur, predHpHolder, curHpHolder] = search(key, 0);
+    if(!equals(cur, key))
+    {
+      return false;
+    }
+    // cur is still protected by curHpHolder while it is published to the other hazard pointer
+    node = cur;
+    nodeHpHolder.store(node);
+  }
+  for(int level = node->mHeight - 1; 1 <= level; --level)
+  {
+    auto [next, mark] = node->mNext[level].load(std::memory_order_relaxed);
+    while(!mark && !node->mNext[level].compare_exchange_weak(next, next, mark, true, std::memory_order_relaxed, std::memory_order_relaxed));
+  }
+  auto [next, mark] = node->mNext[0].load(std::memory_order_relaxed);
+  while(true)
+  {
+    if(mark)
+    {
+      // another thread has removed it
+      return false;
+    }
+    if(node->mNext[0].compare_exchange_weak(next, next, mark, true, std::memory_order_release, std::memory_order_relaxed))
+    {
+      break;
+    }
+  }
+  mSize.add(-1);
+  // unlinks the node from every level
+  search(key, 0);
+  nodeHpHolder.store(nullptr);
+  release(node);
+  return true;
+}
+template <typename Key, typename Value, typename Compare, typename Reclaimer, typename NodeAllocator>
+std::optional<Value> LockFreeSkipList<Key, Value, Compare, Reclaimer, NodeAllocator>::find(const Key& key)
+{
+  auto [pred, cur, predHpHolder, curHpHolder] = search(key, 0);
+  return equals(cur, key) ? std::optional<Value>(cur->mValue.second) : std::nullopt;
+}
+template <typename Key, typename Value, typename Compare, typename Reclaimer, typename NodeAllocator>
+bool LockFreeSkipList<Key, Value, Compare, Reclaimer, NodeAllocator>::contains(const Key& key)
+{
+  auto [pred, cur, predHpHolder, curHpHolder] = search(key, 0);
+  return equals(cur, key);
+}
+template <typename Key, typename Value, typename Compare, typename Reclaimer, typename NodeAllocator>
+auto LockFreeSkipList<Key, Value, Compare, Reclaimer, NodeAllocator>::lower_bound(const Key& key) -> Iterator
+{
+  Iterator it(this, nullptr);
+  it.mHolder.emplace(mReclaimer.makeHolder(4));
+  it.mNextHolder.emplace(mReclaimer.makeHolder(5));
+  auto [pred, cur, predHpHolder, curHpHolder] = search(key, 0);
+  it.mHolder->store(cur);
+  it.mNode = cur;
+  return it;
+}
+template <typename Key, typename Value, typename Compare, typename Reclaimer, typename NodeAllocator>
+auto LockFreeSkipList<Key, Value, Compare, Reclaimer, NodeAllocator>::begin() -> Iterator
+{
+  Iterator it(this, nullptr);
+  it.mHolder.emplace(mReclaimer.makeHolder(4));
+  it.mNextHolder.emplace(mReclaimer.makeHolder(5));
+  // the first element which is not marked, the marked ones are skipped by operator++
+  auto first = claimMarkablePointer(mHead->mNext[0], *it.mHolder);
+  it.mNode = static_cast<ValueNode*>(first);
+  if(first && first->mNext[0].load(std::memory_order_acquire).second)
+  {
+    ++it;
+  }
+  return it;
+}
+template <typename Key, typename Value, typename Compare, typename Reclaimer, typename NodeAllocator>
+auto LockFreeSkipList<Key, Value, Compare, Reclaimer, NodeAllocator>::Iterator::operator++() -> Iterator&
+{
+  using std::swap;
+  assert(mNode);
+  while(true)
+  {
+    bool mark;
+    auto next = claimMarkablePointer(mNode->mNext[0], *mNextHolder, &mark);
+    if(mark)
+    {
+      // the node has been removed and its successor may have been reclaimed, so the position is searched again
+      auto [pred, cur, predHpHolder, curHpHolder] = mMap->search(mNode->mValue.first, 0, true);
+      mHolder->store(cur);
+      mNode = cur;
+      return *this;
+    }
+    swap(*mHolder, *mNextHolder);
+    mNode = static_cast<ValueNode*>(next);
+    if(!mNode || !mNode->mNext[0].load(std::memory_order_acquire).second)
+    {
+      return *this;
+    }
+  }
+}
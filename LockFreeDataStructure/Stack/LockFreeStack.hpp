@@ -3,12 +3,14 @@
 #include <atomic>
 #include <array>
 #include <memory>
+#include <iterator>
 #include <thread>
 #include <functional>
 #include <iostream>
 #include "HazardPointer.hpp"
+#include "NodePool.hpp"
 
-template <typename T>
+template <typename T, typename Reclaimer = HazardPointerDomain<>, typename NodeAllocator = NewDeleteNodeAllocator>
 class LockFreeStack
 {
 private:
@@ -18,67 +20,84 @@ private:
     Node* mNext;
     Node(const T& val): mData(std::make_shared<T>(val)), mNext(nullptr) {}
   };
+  // iterates the nodes of a chain detached by clear, which no other thread modifies
+  class ChainIterator
+  {
+  private:
+    Node* mNode;
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Node*;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Node* const*;
+    using reference = Node* const&;
+    explicit ChainIterator(Node* node) noexcept: mNode(node) {}
+    reference operator*() const noexcept { return mNode; }
+    ChainIterator& operator++() noexcept { mNode = mNode->mNext; return *this; }
+    bool operator==(const ChainIterator& other) const noexcept { return mNode == other.mNode; }
+    bool operator!=(const ChainIterator& other) const noexcept { return mNode != other.mNode; }
+  };
   std::atomic<Node*> mHead; // operation on this variable have to be memory_order_seq_cst to use hazard pointer
+  Reclaimer& mReclaimer;
   static void deleteNode(void* node);
 public:
-  LockFreeStack();
+  explicit LockFreeStack(Reclaimer& reclaimer = Reclaimer::defaultDomain());
   ~LockFreeStack();
   void push(const T& val);
   std::shared_ptr<T> pop();
+  void clear();
 };
 
-template <typename T>
-void LockFreeStack<T>::deleteNode(void* node)
+template <typename T, typename Reclaimer, typename NodeAllocator>
+void LockFreeStack<T, Reclaimer, NodeAllocator>::deleteNode(void* node)
 {
-  delete reinterpret_cast<Node*>(node);
+  NodeAllocator::destroy(reinterpret_cast<Node*>(node));
 }
-template <typename T>
-LockFreeStack<T>::LockFreeStack(): mHead(nullptr) {}
-template <typename T>
-LockFreeStack<T>::~LockFreeStack()
+template <typename T, typename Reclaimer, typename NodeAllocator>
+LockFreeStack<T, Reclaimer, NodeAllocator>::LockFreeStack(Reclaimer& reclaimer): mHead(nullptr), mReclaimer(reclaimer) {}
+template <typename T, typename Reclaimer, typename NodeAllocator>
+LockFreeStack<T, Reclaimer, NodeAllocator>::~LockFreeStack()
 {
   auto node = mHead.load(std::memory_order_seq_cst);
   while(node)
   {
     auto next = node->mNext;
-    delete node;
+    NodeAllocator::destroy(node);
     node = next;
   }
 }
-template <typename T>
-void LockFreeStack<T>::push(const T& val)
+template <typename T, typename Reclaimer, typename NodeAllocator>
+void LockFreeStack<T, Reclaimer, NodeAllocator>::push(const T& val)
 {
-  auto node = new Node(val);
+  auto node = NodeAllocator::template create<Node>(val);
   node->mNext = mHead.load();
   while(!mHead.compare_exchange_weak(node->mNext, node, std::memory_order_seq_cst, std::memory_order_relaxed));
 }
-template <typename T>
-std::shared_ptr<T> LockFreeStack<T>::pop()
+template <typename T, typename Reclaimer, typename NodeAllocator>
+std::shared_ptr<T> LockFreeStack<T, Reclaimer, NodeAllocator>::pop()
 {
-  auto& hazardPointer = HazardPointerDomain<>::getHazardPointerForCurrentThread();
+  auto hp = mReclaimer.makeHolder();
   Node* oldHead;
   do
   {
-    Node* temp;
-    do
-    {
-      oldHead = mHead.load(std::memory_order_seq_cst);
-      hazardPointer.store(oldHead);
-      temp = mHead.load(std::memory_order_seq_cst);
-    }
-    while(oldHead != temp);
+    oldHead = claimPointer(mHead, hp);
   }
   while(oldHead && !mHead.compare_exchange_strong(oldHead, oldHead->mNext, std::memory_order_seq_cst, std::memory_order_relaxed));
-  hazardPointer.store(nullptr, std::memory_order_seq_cst);
+  hp.release();
   
   std::shared_ptr<T> ans;
   if(oldHead)
   {
     using std::swap;
     swap(ans, oldHead->mData);
-    HazardPointerDomain<>::retire(oldHead, &LockFreeStack::deleteNode);
+    mReclaimer.retire(oldHead, &LockFreeStack::deleteNode);
   }
   return ans;
 }
-
-
+// detaches the whole stack with a single exchange and retires the nodes as a batch.
+template <typename T, typename Reclaimer, typename NodeAllocator>
+void LockFreeStack<T, Reclaimer, NodeAllocator>::clear()
+{
+  auto node = mHead.exchange(nullptr, std::memory_order_seq_cst);
+  mReclaimer.retireBatch(ChainIterator(node), ChainIterator(nullptr), &LockFreeStack::deleteNode);
+}
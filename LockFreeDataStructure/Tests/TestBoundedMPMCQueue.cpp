@@ -0,0 +1,108 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BoundedMPMCQueue.hpp"
+
+BOOST_AUTO_TEST_CASE(TestSingleThreadBoundedMPMCQueue)
+{
+  BoundedMPMCQueue<std::string> queue(5);
+  BOOST_CHECK_EQUAL(queue.capacity(), 8u);
+  BOOST_CHECK(queue.empty());
+  BOOST_CHECK(!queue.tryPop().has_value());
+  // several laps around the ring
+  for(int lap = 0; lap < 3; ++lap)
+  {
+    for(int i = 0; i < 8; ++i)
+    {
+      BOOST_CHECK(queue.tryPush(std::to_string(i)));
+    }
+    BOOST_CHECK(!queue.tryPush("full"));
+    BOOST_CHECK(!queue.tryEmplace(3, 'a'));
+    for(int i = 0; i < 8; ++i)
+    {
+      auto value = queue.tryPop();
+      BOOST_REQUIRE(value.has_value());
+      BOOST_CHECK_EQUAL(*value, std::to_string(i));
+    }
+    BOOST_CHECK(queue.empty());
+  }
+  BOOST_CHECK(queue.tryEmplace(3, 'a'));
+  std::string value;
+  BOOST_CHECK(queue.tryPop(value));
+  BOOST_CHECK_EQUAL(value, "aaa");
+}
+
+BOOST_AUTO_TEST_CASE(TestBoundedMPMCQueueDestroysElements)
+{
+  auto counter = std::make_shared<int>(0);
+  {
+    BoundedMPMCQueue<std::shared_ptr<int>> queue(16);
+    for(int i = 0; i < 10; ++i)
+    {
+      queue.push(counter);
+    }
+    std::shared_ptr<int> p;
+    queue.waitAndPop(p);
+    p.reset();
+    BOOST_CHECK_EQUAL(counter.use_count(), 10);
+  }
+  BOOST_CHECK_EQUAL(counter.use_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestBoundedMPMCQueue)
+{
+  static constexpr int numPush = 20000;
+  static constexpr int numPushThread = 4;
+  static constexpr int numPopThread = 4;
+  // a small ring, so that producers wait for consumers and cells are reused many times
+  BoundedMPMCQueue<std::unique_ptr<std::pair<int, int>>> queue(16);
+  std::vector<std::future<void>> pushDone;
+  std::vector<std::future<std::vector<std::pair<int, int>>>> popDone;
+  for(int i = 0; i < numPushThread; ++i)
+  {
+    pushDone.push_back(std::async(std::launch::async, [&queue, i](){
+      for(int j = 0; j < numPush; ++j)
+      {
+        queue.push(std::make_unique<std::pair<int, int>>(i, j));
+      }
+    }));
+  }
+  for(int i = 0; i < numPopThread; ++i)
+  {
+    popDone.push_back(std::async(std::launch::async, [&queue](){
+      std::vector<std::pair<int, int>> ans;
+      for(int j = 0; j < numPush * numPushThread / numPopThread; ++j)
+      {
+        std::unique_ptr<std::pair<int, int>> p;
+        queue.waitAndPop(p);
+        ans.push_back(*p);
+      }
+      return ans;
+    }));
+  }
+  for(auto& fut: pushDone)
+  {
+    fut.get();
+  }
+  std::vector<std::vector<bool>> seen(numPushThread, std::vector<bool>(numPush, false));
+  for(auto& fut: popDone)
+  {
+    auto values = fut.get();
+    // the elements of a producer are popped by a consumer in the order they were pushed
+    std::vector<int> last(numPushThread, -1);
+    for(auto [i, j]: values)
+    {
+      BOOST_REQUIRE(0 <= i && i < numPushThread && 0 <= j && j < numPush);
+      BOOST_CHECK(last[i] < j);
+      last[i] = j;
+      BOOST_CHECK(!seen[i][j]);
+      seen[i][j] = true;
+    }
+  }
+  BOOST_CHECK(queue.empty());
+}
@@ -0,0 +1,104 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+#include <future>
+#include <string>
+#include <vector>
+#include "ConcurrentCache.hpp"
+#include "EpochBasedReclamation.hpp"
+
+using Reclaimers = boost::mpl::list<HazardPointerDomain<3>, EpochDomain>;
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestSingleThreadConcurrentCache, Reclaimer, Reclaimers)
+{
+  {
+    static constexpr std::size_t capacity = 100;
+    ConcurrentCache<int, int, std::hash<int>, UnitWeigher, Reclaimer> cache(capacity);
+    BOOST_CHECK(!cache.get(0).has_value());
+    cache.put(0, 0);
+    BOOST_CHECK_EQUAL(*cache.get(0), 0);
+    cache.put(0, 1);
+    BOOST_CHECK_EQUAL(*cache.get(0), 1);
+    BOOST_CHECK_EQUAL(cache.weight(), 1u);
+    for(int i = 1; i < 200; ++i)
+    {
+      cache.put(i, i);
+      BOOST_CHECK(cache.weight() <= capacity);
+    }
+    // a key which is hit between the inserts gets second chances and stays in the cache
+    cache.put(0, 0);
+    for(int i = 200; i < 1000; ++i)
+    {
+      BOOST_CHECK(cache.get(0).has_value());
+      cache.put(i, i);
+      BOOST_CHECK(cache.weight() <= capacity);
+    }
+    // eviction runs in batches down to 1/32 below the capacity
+    auto weight = cache.weight();
+    BOOST_CHECK(capacity - capacity / 32 <= weight);
+    BOOST_CHECK_EQUAL(cache.size(), weight);
+    BOOST_CHECK(cache.get(999).has_value());
+    BOOST_CHECK(cache.remove(999));
+    BOOST_CHECK(!cache.remove(999));
+    BOOST_CHECK_EQUAL(cache.weight(), weight - 1);
+  }
+  {
+    // the capacity is in bytes
+    struct StringWeigher
+    {
+      std::size_t operator()(int, const std::string& value) const noexcept { return value.size(); }
+    };
+    ConcurrentCache<int, std::string, std::hash<int>, StringWeigher, Reclaimer> cache(1000);
+    for(int i = 0; i < 100; ++i)
+    {
+      cache.put(i, std::string(100, 'a'));
+      BOOST_CHECK(cache.weight() <= 1000u);
+    }
+    BOOST_CHECK_EQUAL(cache.size(), 10u);
+    cache.put(99, std::string(500, 'b'));
+    BOOST_CHECK(cache.weight() <= 1000u);
+    BOOST_CHECK_EQUAL(cache.get(99)->size(), 500u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestConcurrentCache, Reclaimer, Reclaimers)
+{
+  static constexpr std::size_t numThreads = 4;
+  static constexpr int numOps = 20000;
+  static constexpr int numKeys = 4000;
+  static constexpr std::size_t capacity = 500;
+  ConcurrentCache<int, int, std::hash<int>, UnitWeigher, Reclaimer> cache(capacity);
+  std::vector<std::future<int>> done;
+  for(std::size_t t = 0; t < numThreads; ++t)
+  {
+    done.push_back(std::async(std::launch::async, [&cache, t](){
+      int errors = 0;
+      unsigned int state = t + 1;
+      for(int i = 0; i < numOps; ++i)
+      {
+        state = state * 1103515245 + 12345;
+        // a quarter of the keys are hot
+        auto key = static_cast<int>((state >> 8) % (i % 2 ? numKeys / 4 : numKeys));
+        auto value = cache.get(key);
+        if(value)
+        {
+          errors += *value != -key;
+        }
+        else
+        {
+          cache.put(key, -key);
+        }
+      }
+      return errors;
+    }));
+  }
+  for(auto& fut: done)
+  {
+    BOOST_CHECK_EQUAL(fut.get(), 0);
+  }
+  cache.put(numKeys, -numKeys);
+  BOOST_CHECK(cache.weight() <= capacity);
+  BOOST_CHECK_EQUAL(cache.weight(), cache.size());
+}
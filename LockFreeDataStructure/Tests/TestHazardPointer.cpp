@@ -0,0 +1,155 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <new>
+#include "HazardPointer.hpp"
+
+BOOST_AUTO_TEST_CASE(TestBackgroundReclamation)
+{
+  static constexpr int numThread = 4;
+  std::atomic<int> deleted{0};
+  HazardPointerDomain<> domain;
+  std::vector<std::thread> threads;
+  for(int i = 0; i < numThread; ++i)
+  {
+    threads.emplace_back([&domain, &deleted](){
+      // a single node does not reach the threshold, so it is moved to the global list when the thread exits
+      domain.retire(new int(0), [&deleted](void* p){ delete reinterpret_cast<int*>(p); deleted.fetch_add(1); });
+    });
+  }
+  for(auto& t: threads)
+  {
+    t.join();
+  }
+  BOOST_CHECK_EQUAL(deleted.load(), 0);
+  domain.startBackgroundReclamation(std::chrono::milliseconds(1));
+  for(int i = 0; i < 10000 && deleted.load() != numThread; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  BOOST_CHECK_EQUAL(deleted.load(), numThread);
+  domain.stopBackgroundReclamation();
+}
+
+BOOST_AUTO_TEST_CASE(TestMaxPendingPerThread)
+{
+  static constexpr std::size_t maxPending = 4;
+  std::atomic<int> deleted{0};
+  HazardPointerDomain<> domain;
+  {
+    // register hazard pointers of other threads so that the default threshold is larger than the limit
+    std::vector<std::thread> threads;
+    for(int i = 0; i < 16; ++i)
+    {
+      threads.emplace_back([&domain](){ domain.getHazardPointerForCurrentThread(); });
+    }
+    for(auto& t: threads)
+    {
+      t.join();
+    }
+  }
+  domain.setMaxPendingPerThread(maxPending);
+  BOOST_CHECK_EQUAL(domain.getMaxPendingPerThread(), maxPending);
+  for(int i = 1; i <= 100; ++i)
+  {
+    domain.retire(new int(i), [&deleted](void* p){ delete reinterpret_cast<int*>(p); deleted.fetch_add(1); });
+    BOOST_CHECK(static_cast<std::size_t>(i - deleted.load()) <= maxPending);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestStats)
+{
+  HazardPointerDomain<> domain;
+  {
+    auto stats = domain.getStats();
+    BOOST_CHECK_EQUAL(stats.mRetired, 0u);
+    BOOST_CHECK_EQUAL(stats.mFreed, 0u);
+    BOOST_CHECK_EQUAL(stats.mScans, 0u);
+  }
+  std::thread([&domain](){
+    // the node is protected, so it survives the scans and is moved to the global list when the thread exits
+    auto protectedNode = new int(0);
+    auto holder = domain.makeHolder();
+    holder.store(protectedNode);
+    domain.retire(protectedNode, [](void* p){ delete reinterpret_cast<int*>(p); }, sizeof(int));
+    for(int i = 0; i < 100; ++i)
+    {
+      domain.retire(new int(i), [](void* p){ delete reinterpret_cast<int*>(p); }, sizeof(int));
+    }
+    auto stats = domain.getStats();
+    BOOST_CHECK_EQUAL(stats.mRetired, 101u);
+    BOOST_CHECK(stats.mScans > 0u);
+    BOOST_CHECK(stats.mAverageScanLength > 0.0);
+    BOOST_CHECK_EQUAL(stats.mPendingPerThread.size(), 1u);
+    BOOST_CHECK_EQUAL(stats.mFreed + stats.mPendingPerThread[0], 101u);
+    BOOST_CHECK_EQUAL(stats.mPendingGlobal, 0u);
+    BOOST_CHECK_EQUAL(stats.mPendingBytes, stats.mPendingPerThread[0] * sizeof(int));
+    holder.release();
+  }).join();
+  auto stats = domain.getStats();
+  BOOST_CHECK(stats.mPendingPerThread.empty());
+  BOOST_CHECK_EQUAL(stats.mPendingGlobal + stats.mFreed, 101u);
+  BOOST_CHECK(stats.mPendingGlobal > 0u);
+  domain.startBackgroundReclamation(std::chrono::milliseconds(1));
+  for(int i = 0; i < 10000 && domain.getStats().mPendingGlobal != 0; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  domain.stopBackgroundReclamation();
+  stats = domain.getStats();
+  BOOST_CHECK_EQUAL(stats.mFreed, 101u);
+  BOOST_CHECK_EQUAL(stats.mPendingGlobal, 0u);
+  BOOST_CHECK_EQUAL(stats.mPendingBytes, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(TestRetireBatch)
+{
+  HazardPointerDomain<> domain;
+  std::atomic<int> deleted{0};
+  std::vector<int*> nodes;
+  for(int i = 0; i < 100; ++i)
+  {
+    nodes.push_back(new int(i));
+  }
+  domain.retireBatch(nodes.begin(), nodes.end(), [&deleted](void* p){ delete reinterpret_cast<int*>(p); deleted.fetch_add(1); });
+  auto stats = domain.getStats();
+  BOOST_CHECK_EQUAL(stats.mRetired, 100u);
+  BOOST_CHECK_EQUAL(stats.mScans, 1u);
+  BOOST_CHECK_EQUAL(deleted.load(), 100);
+  domain.retireBatch(nodes.end(), nodes.end(), [](void*){});
+  BOOST_CHECK_EQUAL(domain.getStats().mRetired, 100u);
+}
+
+BOOST_AUTO_TEST_CASE(TestRetireBatchRollback)
+{
+  // the range throws in the middle as an allocation would, then none of the nodes is retired
+  struct ThrowingIterator
+  {
+    int* mNode;
+    int mRest;
+    int* operator*() const { return mNode; }
+    ThrowingIterator& operator++()
+    {
+      if(--mRest == 0)
+      {
+        throw std::bad_alloc();
+      }
+      return *this;
+    }
+    bool operator==(const ThrowingIterator& other) const { return mRest == other.mRest; }
+    bool operator!=(const ThrowingIterator& other) const { return mRest != other.mRest; }
+  };
+  HazardPointerDomain<> domain;
+  int deleted = 0;
+  int node = 0;
+  BOOST_CHECK_THROW(
+    domain.retireBatch(ThrowingIterator{&node, 10}, ThrowingIterator{&node, -1}, [&deleted](void*){ ++deleted; }),
+    std::bad_alloc);
+  BOOST_CHECK_EQUAL(deleted, 0);
+  BOOST_CHECK_EQUAL(domain.getStats().mRetired, 0u);
+}
@@ -2,9 +2,11 @@
 #define BOOST_TEST_MAIN
 
 #include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
 #include <thread>
 #include <chrono>
 #include <string>
+#include <string_view>
 #include <future>
 #include <vector>
 #include <random>
@@ -12,6 +14,11 @@
 #include <condition_variable>
 #include <algorithm>
 #include "LockFreeHashMap.hpp"
+#include "EpochBasedReclamation.hpp"
+#include "QuiescentStateBasedReclamation.hpp"
+#include "IntervalBasedReclamation.hpp"
+
+using Reclaimers = boost::mpl::list<HazardPointerDomain<3>, EpochDomain, IntervalDomain, QuiescentStateDomain>;
 
 BOOST_AUTO_TEST_CASE(TestAtomicMarkablePointer)
 {
@@ -79,10 +86,57 @@ BOOST_AUTO_TEST_CASE(TestSingleThreadLockFreeExtendibleBucket)
     BOOST_CHECK_EQUAL(i, i);
   }
 }
-BOOST_AUTO_TEST_CASE(TestSingleThreadLockFreeHashMap)
+BOOST_AUTO_TEST_CASE(TestLockFreeExtendibleBucketHugePage)
+{
+  // a leaf fills a huge page, the directory keeps its elements while it grows and frees the leaves beyond the size after a shrink
+  static constexpr std::size_t baseArraySize = HugePageLeafAllocator::sHugePageSize / sizeof(int);
+  using Bucket = LockFreeExtendibleBucket<int, baseArraySize, DefaultInitializer, HugePageLeafAllocator>;
+  static_assert(Bucket::sLeafSize == HugePageLeafAllocator::sHugePageSize);
+  // the leaves of the bucket directory of LockFreeHashMap with 1 << 18 buckets per leaf
+  static_assert(LockFreeExtendibleBucket<std::atomic<void*>, 1 << 18, DefaultInitializer, HugePageLeafAllocator>::sLeafSize == HugePageLeafAllocator::sHugePageSize);
+  Bucket bucket(4);
+  BOOST_CHECK_EQUAL(bucket.size(), 4u);
+  while(bucket.size() < 4 * baseArraySize)
+  {
+    BOOST_CHECK(bucket.extend());
+  }
+  for(std::size_t i = 0; i < bucket.size(); i += 1023)
+  {
+    BOOST_CHECK_EQUAL(bucket[i], 0);
+    bucket[i] = static_cast<int>(i);
+  }
+  for(std::size_t i = 0; i < bucket.size(); i += 1023)
+  {
+    BOOST_CHECK_EQUAL(bucket[i], static_cast<int>(i));
+  }
+  BOOST_CHECK(bucket.shrink());
+  BOOST_CHECK_EQUAL(bucket.size(), 2 * baseArraySize);
+  std::size_t released = 0;
+  bucket.releaseFrom(bucket.size(), [&released](int& elem){ released += elem != 0; });
+  std::size_t expected = 0;
+  for(std::size_t i = 0; i < 4 * baseArraySize; i += 1023)
+  {
+    expected += 2 * baseArraySize <= i;
+  }
+  BOOST_CHECK_EQUAL(released, expected);
+  BOOST_CHECK(bucket.extend());
+  BOOST_CHECK_EQUAL(bucket[3 * baseArraySize], 0);
+  BOOST_CHECK_EQUAL(bucket[1023], 1023);
+
+  LockFreeHashMap<int, int, std::hash<int>, (1 << 18), HazardPointerDomain<3>, PoolNodeAllocator, HugePageLeafAllocator> map;
+  for(int i = 0; i < 10000; ++i)
+  {
+    BOOST_CHECK(map.insert({i, -i}));
+  }
+  for(int i = 0; i < 10000; ++i)
+  {
+    BOOST_CHECK_EQUAL(*map.find(i), -i);
+  }
+}
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestSingleThreadLockFreeHashMap, Reclaimer, Reclaimers)
 {
   {
-    LockFreeHashMap<int, int> map;
+    LockFreeHashMap<int, int, std::hash<int>, 1 << 10, Reclaimer> map;
     BOOST_CHECK(map.insert({42, 42}));
     auto res = map.find(42);
     BOOST_CHECK(res.has_value());
@@ -152,10 +206,10 @@ BOOST_AUTO_TEST_CASE(TestSingleThreadLockFreeHashMap)
     }
   }
 }
-BOOST_AUTO_TEST_CASE(TestLockFreeHashMap)
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestLockFreeHashMap, Reclaimer, Reclaimers)
 {
   {
-    LockFreeHashMap<int, int> map;
+    LockFreeHashMap<int, int, std::hash<int>, 1 << 10, Reclaimer> map;
     std::promise<void> start;
     std::vector<std::future<void>> ready;
     std::vector<std::future<void>> done;
@@ -204,3 +258,447 @@ BOOST_AUTO_TEST_CASE(TestLockFreeHashMap)
   }
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestLockFreeHashMapForEach, Reclaimer, Reclaimers)
+{
+  {
+    static constexpr int numElem = 10000;
+    LockFreeHashMap<int, int, std::hash<int>, 1 << 10, Reclaimer> map;
+    std::vector<int> keys;
+    map.for_each([&keys](const int& key, const int&){ keys.push_back(key); });
+    BOOST_CHECK(keys.empty());
+    std::vector<int> expected;
+    for(int i = 0; i < numElem; ++i)
+    {
+      map.insert({i, -i});
+      expected.push_back(i);
+    }
+    map.for_each([&keys](const int& key, const int& value){
+      BOOST_CHECK_EQUAL(key, -value);
+      keys.push_back(key);
+    });
+    std::sort(keys.begin(), keys.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(keys.begin(), keys.end(), expected.begin(), expected.end());
+
+    static constexpr std::size_t numPartition = 4;
+    BOOST_REQUIRE(numPartition <= map.bucketCount());
+    std::vector<std::future<std::vector<int>>> partitions;
+    for(std::size_t i = 0; i < numPartition; ++i)
+    {
+      partitions.push_back(std::async(std::launch::async, [&map, i](){
+        std::vector<int> ans;
+        map.for_each(i, numPartition, [&ans](const int& key, const int&){ ans.push_back(key); });
+        return ans;
+      }));
+    }
+    keys.clear();
+    for(auto& fut: partitions)
+    {
+      auto vec = fut.get();
+      keys.insert(keys.end(), vec.begin(), vec.end());
+    }
+    std::sort(keys.begin(), keys.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(keys.begin(), keys.end(), expected.begin(), expected.end());
+
+    // odd keys are removed and inserted during the iteration, even keys stay in the map
+    std::atomic<bool> done = false;
+    auto modifier = std::async(std::launch::async, [&map, &done](){
+      while(!done.load())
+      {
+        for(int i = 1; i < numElem; i += 2)
+        {
+          map.remove(i);
+        }
+        for(int i = 1; i < numElem; i += 2)
+        {
+          map.insert({i, -i});
+        }
+      }
+    });
+    for(int n = 0; n < 10; ++n)
+    {
+      keys.clear();
+      map.for_each([&keys](const int& key, const int&){ keys.push_back(key); });
+      std::sort(keys.begin(), keys.end());
+      BOOST_CHECK(std::adjacent_find(keys.begin(), keys.end()) == keys.end());
+      std::vector<int> evens;
+      std::copy_if(keys.begin(), keys.end(), std::back_inserter(evens), [](int key){ return key % 2 == 0; });
+      BOOST_CHECK_EQUAL(evens.size(), static_cast<std::size_t>(numElem / 2));
+    }
+    done.store(true);
+    modifier.wait();
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestLockFreeHashMapUpdate, Reclaimer, Reclaimers)
+{
+  {
+    LockFreeHashMap<int, int, std::hash<int>, 1 << 10, Reclaimer> map;
+    BOOST_CHECK(map.insert_or_assign({1, 1}));
+    BOOST_CHECK(!map.insert_or_assign({1, 2}));
+    BOOST_CHECK_EQUAL(*map.find(1), 2);
+    BOOST_CHECK_EQUAL(map.size(), 1u);
+
+    auto increment = [](const int* current) { return std::optional<int>(current ? *current + 1 : 0); };
+    BOOST_CHECK_EQUAL(*map.compute(1, increment), 3);
+    BOOST_CHECK_EQUAL(*map.compute(2, increment), 0);
+    BOOST_CHECK_EQUAL(map.size(), 2u);
+    BOOST_CHECK(!map.compute(2, [](const int*) { return std::optional<int>(); }).has_value());
+    BOOST_CHECK(!map.find(2).has_value());
+    BOOST_CHECK(!map.compute(3, [](const int*) { return std::optional<int>(); }).has_value());
+    BOOST_CHECK_EQUAL(map.size(), 1u);
+
+    BOOST_CHECK(!map.erase_if(1, [](const int& value) { return value != 3; }));
+    BOOST_CHECK_EQUAL(*map.find(1), 3);
+    BOOST_CHECK(map.erase_if(1, [](const int& value) { return value == 3; }));
+    BOOST_CHECK(!map.erase_if(1, [](const int&) { return true; }));
+    BOOST_CHECK(map.empty());
+  }
+  {
+    // counters are incremented concurrently and a reader never misses a key while its value is replaced
+    static constexpr int numKeys = 16;
+    static constexpr std::size_t numThreads = 4;
+    static constexpr int numIncrement = 5000;
+    LockFreeHashMap<int, int, std::hash<int>, 1 << 10, Reclaimer> map;
+    for(int i = 0; i < numKeys; ++i)
+    {
+      map.insert({i, 0});
+    }
+    std::atomic<bool> done = false;
+    auto reader = std::async(std::launch::async, [&map, &done](){
+      std::size_t missed = 0;
+      while(!done.load())
+      {
+        for(int i = 0; i < numKeys; ++i)
+        {
+          missed += map.find(i).has_value() ? 0 : 1;
+        }
+      }
+      return missed;
+    });
+    std::vector<std::future<void>> writers;
+    for(std::size_t i = 0; i < numThreads; ++i)
+    {
+      writers.push_back(std::async(std::launch::async, [&map](){
+        for(int j = 0; j < numIncrement; ++j)
+        {
+          map.compute(j % numKeys, [](const int* current) { return std::optional<int>(*current + 1); });
+        }
+      }));
+    }
+    for(auto& fut: writers)
+    {
+      fut.wait();
+    }
+    done.store(true);
+    BOOST_CHECK_EQUAL(reader.get(), 0u);
+    int sum = 0;
+    for(int i = 0; i < numKeys; ++i)
+    {
+      sum += *map.find(i);
+    }
+    BOOST_CHECK_EQUAL(sum, static_cast<int>(numThreads) * numIncrement);
+    BOOST_CHECK_EQUAL(map.size(), static_cast<std::size_t>(numKeys));
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestLockFreeHashMapBulkLoad, Reclaimer, Reclaimers)
+{
+  {
+    LockFreeHashMap<int, int, std::hash<int>, 1 << 10, Reclaimer> map(static_cast<std::pair<int, int>*>(nullptr), static_cast<std::pair<int, int>*>(nullptr));
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.insert({1, 1}));
+    BOOST_CHECK_EQUAL(*map.find(1), 1);
+  }
+  {
+    static constexpr int numElem = 50000;
+    std::vector<std::pair<int, int>> elems;
+    for(int i = 0; i < numElem; ++i)
+    {
+      elems.emplace_back(i, -i);
+    }
+    // duplicated keys, the first ones are kept
+    for(int i = 0; i < numElem; i += 3)
+    {
+      elems.emplace_back(i, i);
+    }
+    std::shuffle(elems.begin(), elems.end() - numElem / 3 - 1, std::mt19937(42));
+    LockFreeHashMap<int, int, std::hash<int>, 1 << 10, Reclaimer> map(elems.begin(), elems.end(), 4);
+    BOOST_CHECK_EQUAL(map.size(), static_cast<std::size_t>(numElem));
+    BOOST_CHECK(numElem <= map.bucketCount() * 2);
+    for(int i = 0; i < numElem; ++i)
+    {
+      auto res = map.find(i);
+      BOOST_REQUIRE(res.has_value());
+      BOOST_CHECK_EQUAL(*res, -i);
+    }
+    BOOST_CHECK(!map.find(numElem).has_value());
+    std::vector<int> keys;
+    map.for_each(1, 4, [&keys](const int& key, const int&){ keys.push_back(key); });
+    BOOST_CHECK(!keys.empty());
+    for(int i = 0; i < numElem; i += 2)
+    {
+      BOOST_CHECK(map.remove(i));
+    }
+    for(int i = numElem; i < 2 * numElem; ++i)
+    {
+      BOOST_CHECK(map.insert({i, -i}));
+    }
+    for(int i = 0; i < 2 * numElem; ++i)
+    {
+      BOOST_CHECK_EQUAL(map.find(i).has_value(), i % 2 == 1 || numElem <= i);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestLockFreeHashMapShrink, Reclaimer, Reclaimers)
+{
+  {
+    // the bucket directory of the default policy only grows
+    LockFreeHashMap<int, int, std::hash<int>, 1 << 10, Reclaimer> map;
+    for(int i = 0; i < 4096; ++i)
+    {
+      BOOST_CHECK(map.insert({i, -i}));
+    }
+    auto grownBucketCount = map.bucketCount();
+    for(int i = 0; i < 4096; ++i)
+    {
+      BOOST_CHECK(map.remove(i));
+    }
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK_EQUAL(map.bucketCount(), grownBucketCount);
+  }
+  {
+    static constexpr int numElem = 1 << 14;
+    static constexpr int numKept = 16;
+    LockFreeHashMap<int, int, std::hash<int>, 1 << 10, Reclaimer, PoolNodeAllocator, NewLeafAllocator, GrowAndShrink> map;
+    for(int i = 0; i < numElem; ++i)
+    {
+      BOOST_CHECK(map.insert({i, -i}));
+    }
+    auto grownBucketCount = map.bucketCount();
+    BOOST_CHECK(numElem / 4 <= grownBucketCount);
+    for(int i = numKept; i < numElem; ++i)
+    {
+      BOOST_CHECK(map.remove(i));
+    }
+    // the size is sampled once in ShardedCounter::sSampleInterval removals, the directory fits the size at the last sample
+    BOOST_CHECK(map.bucketCount() <= (numKept + ShardedCounter::sSampleInterval) * 8);
+    for(int i = 0; i < numElem; ++i)
+    {
+      BOOST_CHECK_EQUAL(map.find(i).has_value(), i < numKept);
+    }
+    std::vector<int> keys;
+    map.for_each([&keys](const int& key, const int&){ keys.push_back(key); });
+    BOOST_CHECK_EQUAL(keys.size(), static_cast<std::size_t>(numKept));
+    // partitions may outnumber the buckets after a shrink
+    keys.clear();
+    for(std::size_t i = 0; i < 1024; ++i)
+    {
+      map.for_each(i, 1024, [&keys](const int& key, const int&){ keys.push_back(key); });
+    }
+    std::sort(keys.begin(), keys.end());
+    BOOST_CHECK(std::adjacent_find(keys.begin(), keys.end()) == keys.end());
+    BOOST_CHECK_EQUAL(keys.size(), static_cast<std::size_t>(numKept));
+    for(int i = numKept; i < numElem; ++i)
+    {
+      BOOST_CHECK(map.insert({i, i}));
+    }
+    BOOST_CHECK(numElem / 4 <= map.bucketCount());
+    for(int i = 0; i < numElem; ++i)
+    {
+      auto res = map.find(i);
+      BOOST_REQUIRE(res.has_value());
+      BOOST_CHECK_EQUAL(*res, i < numKept ? -i : i);
+    }
+  }
+  {
+    // keys are inserted and removed in waves so that the directory grows and shrinks while other threads use it
+    static constexpr int numThread = 4;
+    static constexpr int numElem = 2000;
+    static constexpr int numRound = 5;
+    static constexpr int numStable = 100;
+    LockFreeHashMap<int, int, std::hash<int>, 1 << 10, Reclaimer, PoolNodeAllocator, NewLeafAllocator, GrowAndShrink> map;
+    for(int i = 0; i < numStable; ++i)
+    {
+      map.insert({-i - 1, i});
+    }
+    std::atomic<bool> done = false;
+    std::atomic<int> errors = 0;
+    auto reader = std::async(std::launch::async, [&map, &done, &errors](){
+      while(!done.load())
+      {
+        int stable = 0;
+        map.for_each([&stable](const int& key, const int&){ stable += key < 0; });
+        errors += stable != numStable;
+        for(int i = 0; i < numStable; ++i)
+        {
+          errors += !map.find(-i - 1).has_value();
+        }
+      }
+    });
+    std::vector<std::future<void>> writers;
+    for(int t = 0; t < numThread; ++t)
+    {
+      writers.push_back(std::async(std::launch::async, [&map, &errors, t](){
+        for(int round = 0; round < numRound; ++round)
+        {
+          for(int i = t * numElem; i < (t + 1) * numElem; ++i)
+          {
+            errors += !map.insert({i, i});
+          }
+          for(int i = t * numElem; i < (t + 1) * numElem; ++i)
+          {
+            errors += !map.remove(i);
+          }
+        }
+      }));
+    }
+    for(auto& fut: writers)
+    {
+      fut.wait();
+    }
+    done.store(true);
+    reader.wait();
+    BOOST_CHECK_EQUAL(errors.load(), 0);
+    BOOST_CHECK_EQUAL(map.size(), static_cast<std::size_t>(numStable));
+    std::vector<int> keys;
+    map.for_each([&keys](const int& key, const int&){ keys.push_back(key); });
+    BOOST_CHECK_EQUAL(keys.size(), static_cast<std::size_t>(numStable));
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestLockFreeHashMapFindMany, Reclaimer, Reclaimers)
+{
+  static constexpr int numKeys = 10000;
+  LockFreeHashMap<int, int, std::hash<int>, 1 << 10, Reclaimer, PoolNodeAllocator, NewLeafAllocator, GrowAndShrink> map;
+  for(int i = 0; i < numKeys; i += 2)
+  {
+    map.insert({i, i});
+  }
+  // the odd keys are inserted and removed while the batches are looked up, so that the bucket directory grows and shrinks
+  auto writer = std::async(std::launch::async, [&map]() {
+    for(int round = 0; round < 3; ++round)
+    {
+      for(int i = 1; i < numKeys; i += 2)
+      {
+        map.insert({i, i});
+      }
+      for(int i = 1; i < numKeys; i += 2)
+      {
+        map.remove(i);
+      }
+    }
+  });
+  std::vector<int> keys(numKeys);
+  for(int i = 0; i < numKeys; ++i)
+  {
+    keys[i] = i;
+  }
+  for(int round = 0; round < 5; ++round)
+  {
+    std::vector<std::optional<int>> values(numKeys);
+    auto end = map.findMany(keys.begin(), keys.end(), values.begin());
+    BOOST_CHECK(end == values.end());
+    int errors = 0;
+    for(int i = 0; i < numKeys; ++i)
+    {
+      errors += i % 2 == 0 ? values[i] != i : values[i].has_value() && *values[i] != i;
+    }
+    BOOST_CHECK_EQUAL(errors, 0);
+  }
+  writer.get();
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestLockFreeHashMapVisit, Reclaimer, Reclaimers)
+{
+  LockFreeHashMap<int, std::vector<int>, std::hash<int>, 1 << 10, Reclaimer> map;
+  BOOST_CHECK(map.insert({0, std::vector<int>(1000, 7)}));
+  const std::vector<int>* first = nullptr;
+  std::size_t size = 0;
+  BOOST_CHECK(map.visit(0, [&first, &size](const std::vector<int>& value){ first = &value; size = value.size(); }));
+  BOOST_CHECK_EQUAL(size, 1000u);
+  // the value is visited in place
+  BOOST_CHECK(map.visit(0, [first](const std::vector<int>& value){ BOOST_CHECK_EQUAL(&value, first); }));
+  BOOST_CHECK(!map.visit(1, [](const std::vector<int>&){ BOOST_ERROR("absent key is visited"); }));
+  // a reader sees either the old or the new value as a whole while the key is replaced
+  auto writer = std::async(std::launch::async, [&map]() {
+    for(int i = 0; i < 1000; ++i)
+    {
+      map.insert_or_assign({0, std::vector<int>(1000, i)});
+    }
+  });
+  int errors = 0;
+  for(int i = 0; i < 1000; ++i)
+  {
+    map.visit(0, [&errors](const std::vector<int>& value){ errors += std::count(value.begin(), value.end(), value.front()) != 1000; });
+  }
+  writer.get();
+  BOOST_CHECK_EQUAL(errors, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestLockFreeHashMapHeterogeneousLookup)
+{
+  struct TransparentStringHash
+  {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view str) const noexcept { return std::hash<std::string_view>()(str); }
+  };
+  {
+    LockFreeHashMap<std::string, int, TransparentStringHash> map;
+    BOOST_CHECK(map.insert({"foo", 1}));
+    BOOST_CHECK(map.insert({"bar", 2}));
+    auto res = map.find(std::string_view("foo"));
+    BOOST_REQUIRE(res.has_value());
+    BOOST_CHECK_EQUAL(*res, 1);
+    BOOST_CHECK(!map.find(std::string_view("baz")).has_value());
+    BOOST_CHECK(map.remove(std::string_view("foo")));
+    BOOST_CHECK(!map.remove(std::string_view("foo")));
+    BOOST_CHECK(!map.find(std::string("foo")).has_value());
+    BOOST_CHECK_EQUAL(*map.find(std::string_view("bar")), 2);
+    int value = 0;
+    BOOST_CHECK(map.visit(std::string_view("bar"), [&value](const int& v){ value = v; }));
+    BOOST_CHECK_EQUAL(value, 2);
+    BOOST_CHECK_EQUAL(map.size(), 1u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestLockFreeHashMapWithOwnHazardPointerDomain)
+{
+  {
+    static constexpr std::size_t numMaps = 4;
+    static constexpr int numInsert = 10000;
+    std::vector<std::unique_ptr<HazardPointerDomain<3>>> domains;
+    std::vector<std::unique_ptr<LockFreeHashMap<int, int>>> maps;
+    for(std::size_t i = 0; i < numMaps; ++i)
+    {
+      domains.push_back(std::make_unique<HazardPointerDomain<3>>());
+      maps.push_back(std::make_unique<LockFreeHashMap<int, int>>(*domains.back()));
+    }
+    std::vector<std::future<void>> done;
+    for(std::size_t i = 0; i < numMaps; ++i)
+    {
+      done.push_back(std::async(std::launch::async, [&map = *maps[i]]() {
+        for(int j = 0; j < numInsert; ++j)
+        {
+          map.insert({j, -j});
+        }
+      }));
+      done.push_back(std::async(std::launch::async, [&map = *maps[i]]() {
+        for(int j = 0; j < numInsert; ++j)
+        {
+          while(!map.remove(j));
+        }
+      }));
+    }
+    for(auto& fut: done)
+    {
+      fut.wait();
+    }
+    for(auto& map: maps)
+    {
+      BOOST_CHECK(map->empty());
+    }
+    // maps have to be destructed before their domains
+    maps.clear();
+  }
+}
@@ -0,0 +1,155 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <future>
+#include <vector>
+#include <algorithm>
+#include "LockFreeOpenAddressingHashMap.hpp"
+
+BOOST_AUTO_TEST_CASE(TestSingleThreadLockFreeOpenAddressingHashMap)
+{
+  LockFreeOpenAddressingHashMap<std::int64_t, std::int64_t> map(16);
+  BOOST_CHECK(map.insert({0, 42}));
+  BOOST_CHECK(!map.insert({0, 43}));
+  BOOST_CHECK_EQUAL(*map.find(0), 42);
+  BOOST_CHECK(!map.insert_or_assign({0, 43}));
+  BOOST_CHECK_EQUAL(*map.find(0), 43);
+  BOOST_CHECK(map.remove(0));
+  BOOST_CHECK(!map.remove(0));
+  BOOST_CHECK(!map.find(0).has_value());
+  BOOST_CHECK(map.insert_or_assign({0, 44}));
+  BOOST_CHECK_EQUAL(*map.find(0), 44);
+
+  // the map grows beyond the initial capacity by chaining tables, the old tables are moved to the new ones and dropped
+  for(std::int64_t i = 1; i < 1000; ++i)
+  {
+    BOOST_CHECK(map.insert({i, -i}));
+  }
+  BOOST_CHECK(map.tableCount() <= 2);
+  BOOST_CHECK_EQUAL(map.size(), 1000u);
+  for(std::int64_t i = 1; i < 1000; ++i)
+  {
+    auto res = map.find(i);
+    BOOST_REQUIRE(res.has_value());
+    BOOST_CHECK_EQUAL(*res, -i);
+    BOOST_CHECK(!map.find(-i).has_value());
+  }
+  for(std::int64_t i = 1; i < 1000; i += 2)
+  {
+    BOOST_CHECK(map.remove(i));
+  }
+  std::vector<std::int64_t> keys;
+  map.for_each([&keys](std::int64_t key, std::int64_t){ keys.push_back(key); });
+  std::sort(keys.begin(), keys.end());
+  BOOST_CHECK_EQUAL(keys.size(), map.size());
+  BOOST_CHECK(std::all_of(keys.begin(), keys.end(), [](std::int64_t key){ return key % 2 == 0; }));
+}
+
+BOOST_AUTO_TEST_CASE(TestLockFreeOpenAddressingHashMap)
+{
+  // threads insert the same keys while the map grows, each key has to be inserted exactly once
+  static constexpr std::size_t numThreads = 8;
+  static constexpr std::int64_t numKeys = 20000;
+  LockFreeOpenAddressingHashMap<std::int64_t, std::int64_t> map(64);
+  std::promise<void> start;
+  auto startFut = start.get_future().share();
+  std::vector<std::future<std::size_t>> done;
+  for(std::size_t i = 0; i < numThreads; ++i)
+  {
+    done.push_back(std::async(std::launch::async, [id = i, &map, startFut](){
+      startFut.wait();
+      std::size_t inserted = 0;
+      for(std::int64_t j = 0; j < numKeys; ++j)
+      {
+        auto key = (j + static_cast<std::int64_t>(id) * 997) % numKeys;
+        inserted += map.insert({key, key}) ? 1 : 0;
+      }
+      return inserted;
+    }));
+  }
+  start.set_value();
+  std::size_t inserted = 0;
+  for(auto& fut: done)
+  {
+    inserted += fut.get();
+  }
+  BOOST_CHECK_EQUAL(inserted, static_cast<std::size_t>(numKeys));
+  BOOST_CHECK_EQUAL(map.size(), static_cast<std::size_t>(numKeys));
+  std::size_t visited = 0;
+  map.for_each([&visited](std::int64_t key, std::int64_t value){
+    BOOST_CHECK_EQUAL(key, value);
+    ++visited;
+  });
+  BOOST_CHECK_EQUAL(visited, static_cast<std::size_t>(numKeys));
+
+  // each key is removed by exactly one thread
+  std::vector<std::future<std::size_t>> removed;
+  for(std::size_t i = 0; i < numThreads; ++i)
+  {
+    removed.push_back(std::async(std::launch::async, [&map](){
+      std::size_t ans = 0;
+      for(std::int64_t j = 0; j < numKeys; ++j)
+      {
+        ans += map.remove(j) ? 1 : 0;
+      }
+      return ans;
+    }));
+  }
+  std::size_t numRemoved = 0;
+  for(auto& fut: removed)
+  {
+    numRemoved += fut.get();
+  }
+  BOOST_CHECK_EQUAL(numRemoved, static_cast<std::size_t>(numKeys));
+  BOOST_CHECK(map.empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestLockFreeOpenAddressingHashMapChurn)
+{
+  // each thread keeps a window of live keys and replaces the oldest one by a new key,
+  // the removed keys do not pile up since the old tables are moved and dropped
+  static constexpr std::size_t numThreads = 4;
+  static constexpr std::int64_t window = 64;
+  static constexpr std::int64_t numOps = 100000;
+  LockFreeOpenAddressingHashMap<std::int64_t, std::int64_t> map(64);
+  std::promise<void> start;
+  auto startFut = start.get_future().share();
+  std::vector<std::future<std::size_t>> done;
+  for(std::size_t i = 0; i < numThreads; ++i)
+  {
+    done.push_back(std::async(std::launch::async, [id = static_cast<std::int64_t>(i), &map, startFut](){
+      startFut.wait();
+      std::size_t maxTableCount = 0;
+      for(std::int64_t j = 0; j < numOps; ++j)
+      {
+        auto key = j * static_cast<std::int64_t>(numThreads) + id;
+        map.insert({key, key});
+        if(window <= j)
+        {
+          map.remove(key - window * static_cast<std::int64_t>(numThreads));
+        }
+        if(j % 1000 == 0)
+        {
+          maxTableCount = std::max(maxTableCount, map.tableCount());
+        }
+      }
+      return maxTableCount;
+    }));
+  }
+  start.set_value();
+  for(auto& fut: done)
+  {
+    BOOST_CHECK(fut.get() <= 4u);
+  }
+  BOOST_CHECK(map.tableCount() <= 2);
+  BOOST_CHECK_EQUAL(map.size(), static_cast<std::size_t>(window * numThreads));
+  std::size_t visited = 0;
+  map.for_each([&visited](std::int64_t key, std::int64_t value){
+    BOOST_CHECK_EQUAL(key, value);
+    BOOST_CHECK(numThreads * (numOps - window) <= static_cast<std::size_t>(key));
+    ++visited;
+  });
+  BOOST_CHECK_EQUAL(visited, static_cast<std::size_t>(window * numThreads));
+}
@@ -0,0 +1,177 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "LockFreeSkipList.hpp"
+#include "EpochBasedReclamation.hpp"
+
+using Reclaimers = boost::mpl::list<HazardPointerDomain<6>, EpochDomain>;
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestSingleThreadLockFreeSkipList, Reclaimer, Reclaimers)
+{
+  LockFreeSkipList<int, std::string, std::less<int>, Reclaimer> list;
+  std::map<int, std::string> expected;
+  BOOST_CHECK(list.empty());
+  BOOST_CHECK(list.begin() == list.end());
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<int> dist(0, 999);
+  for(int i = 0; i < 20000; ++i)
+  {
+    auto key = dist(engine);
+    if(engine() % 2)
+    {
+      BOOST_CHECK_EQUAL(list.insert(key, std::to_string(key)), expected.emplace(key, std::to_string(key)).second);
+    }
+    else
+    {
+      BOOST_CHECK_EQUAL(list.remove(key), expected.erase(key) == 1);
+    }
+  }
+  BOOST_CHECK_EQUAL(list.size(), expected.size());
+  for(int key = -1; key <= 1000; ++key)
+  {
+    auto value = list.find(key);
+    auto it = expected.find(key);
+    BOOST_CHECK_EQUAL(value.has_value(), it != expected.end());
+    BOOST_CHECK_EQUAL(list.contains(key), it != expected.end());
+    if(value && it != expected.end())
+    {
+      BOOST_CHECK_EQUAL(*value, it->second);
+    }
+  }
+  // iteration and range scans follow the key order
+  auto expectedIt = expected.begin();
+  for(auto it = list.begin(); it != list.end(); ++it, ++expectedIt)
+  {
+    BOOST_REQUIRE(expectedIt != expected.end());
+    BOOST_CHECK_EQUAL(it->first, expectedIt->first);
+    BOOST_CHECK_EQUAL(it->second, expectedIt->second);
+  }
+  BOOST_CHECK(expectedIt == expected.end());
+  for(int begin = -1; begin <= 1000; begin += 37)
+  {
+    std::vector<int> keys;
+    for(auto it = list.lower_bound(begin); it != list.end() && it->first < begin + 50; ++it)
+    {
+      keys.push_back(it->first);
+    }
+    std::vector<int> expectedKeys;
+    for(auto it = expected.lower_bound(begin); it != expected.end() && it->first < begin + 50; ++it)
+    {
+      expectedKeys.push_back(it->first);
+    }
+    BOOST_CHECK(keys == expectedKeys);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestLockFreeSkipListIteratorReassignment)
+{
+  // a reassigned iterator keeps its new element alive after the element is removed, even if every retire scans
+  HazardPointerDomain<6> domain;
+  domain.setMaxPendingPerThread(0);
+  LockFreeSkipList<int, std::shared_ptr<int>, std::less<int>, HazardPointerDomain<6>, NewDeleteNodeAllocator> list(std::less<int>(), domain);
+  std::weak_ptr<int> observer;
+  for(int i = 0; i < 4; ++i)
+  {
+    auto value = std::make_shared<int>(i);
+    if(i == 2)
+    {
+      observer = value;
+    }
+    BOOST_CHECK(list.insert(i, value));
+  }
+  {
+    auto it = list.begin();
+    it = list.lower_bound(2);
+    BOOST_REQUIRE(it != list.end());
+    BOOST_CHECK(list.remove(2));
+    list.remove(3);
+    BOOST_CHECK(!observer.expired());
+    BOOST_CHECK_EQUAL(it->first, 2);
+    BOOST_CHECK_EQUAL(*it->second, 2);
+  }
+  list.remove(0);
+  BOOST_CHECK(observer.expired());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestLockFreeSkipList, Reclaimer, Reclaimers)
+{
+  static constexpr int numThreads = 4;
+  static constexpr int numKeys = 4000;
+  LockFreeSkipList<int, int, std::less<int>, Reclaimer> list;
+  std::atomic<bool> done = false;
+  // a scanner sees the keys in increasing order and every value equal to its key while the writers modify the list
+  auto scanner = std::async(std::launch::async, [&list, &done](){
+    int errors = 0;
+    while(!done.load())
+    {
+      int last = -1;
+      for(auto it = list.begin(); it != list.end(); ++it)
+      {
+        errors += it->first <= last || it->first != it->second;
+        last = it->first;
+      }
+    }
+    return errors;
+  });
+  // every thread inserts its own even keys and churns the odd keys shared by all threads
+  std::vector<std::future<int>> writers;
+  for(int t = 0; t < numThreads; ++t)
+  {
+    writers.push_back(std::async(std::launch::async, [&list, t](){
+      int errors = 0;
+      for(int i = 2 * t; i < numKeys; i += 2 * numThreads)
+      {
+        errors += !list.insert(i, i);
+      }
+      std::mt19937 engine(t);
+      for(int i = 0; i < 20000; ++i)
+      {
+        auto key = static_cast<int>(engine() % numKeys) | 1;
+        if(engine() % 2)
+        {
+          list.insert(key, key);
+        }
+        else
+        {
+          list.remove(key);
+        }
+      }
+      return errors;
+    }));
+  }
+  for(auto& fut: writers)
+  {
+    BOOST_CHECK_EQUAL(fut.get(), 0);
+  }
+  done.store(true);
+  BOOST_CHECK_EQUAL(scanner.get(), 0);
+  std::size_t count = 0;
+  int last = -1;
+  for(auto it = list.begin(); it != list.end(); ++it, ++count)
+  {
+    BOOST_CHECK(last < it->first);
+    last = it->first;
+  }
+  BOOST_CHECK_EQUAL(count, list.size());
+  for(int i = 0; i < numKeys; ++i)
+  {
+    if(i % 2 == 0)
+    {
+      BOOST_CHECK(list.contains(i));
+    }
+    else
+    {
+      list.remove(i);
+    }
+  }
+  BOOST_CHECK_EQUAL(list.size(), static_cast<std::size_t>(numKeys / 2));
+}
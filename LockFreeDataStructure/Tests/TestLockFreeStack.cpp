@@ -2,6 +2,7 @@
 #define BOOST_TEST_MAIN
 
 #include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
 #include <thread>
 #include <chrono>
 #include <string>
@@ -11,6 +12,10 @@
 #include <mutex>
 #include <condition_variable>
 #include "LockFreeStack.hpp"
+#include "EpochBasedReclamation.hpp"
+#include "QuiescentStateBasedReclamation.hpp"
+
+using Reclaimers = boost::mpl::list<HazardPointerDomain<>, EpochDomain, QuiescentStateDomain>;
 
 class jthread
 {
@@ -39,11 +44,11 @@ public:
   }
 };
 
-BOOST_AUTO_TEST_CASE(TestLockFreeStack)
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestLockFreeStack, Reclaimer, Reclaimers)
 {
   {
-    LockFreeStack<int> stack1;
-    LockFreeStack<int> stack2;
+    LockFreeStack<int, Reclaimer> stack1;
+    LockFreeStack<int, Reclaimer> stack2;
     std::mutex lock;
     std::condition_variable cond;
     std::atomic<bool> start = false;
@@ -207,3 +212,37 @@ BOOST_AUTO_TEST_CASE(TestLockFreeStack)
   }
 }
 
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestLockFreeStackClear, Reclaimer, Reclaimers)
+{
+  LockFreeStack<int, Reclaimer> stack;
+  stack.clear();
+  BOOST_CHECK(!stack.pop());
+  std::atomic<bool> pushDone = false;
+  {
+    jthread push([&](){
+      for(int i = 0; i < 10000; ++i)
+      {
+        stack.push(i);
+      }
+      pushDone.store(true);
+    });
+    jthread clear([&](){
+      while(!pushDone.load())
+      {
+        stack.clear();
+      }
+    });
+    jthread pop([&](){
+      while(!pushDone.load())
+      {
+        stack.pop();
+      }
+    });
+  }
+  stack.clear();
+  BOOST_CHECK(!stack.pop());
+  stack.push(1);
+  auto p = stack.pop();
+  BOOST_CHECK(p && *p == 1);
+}
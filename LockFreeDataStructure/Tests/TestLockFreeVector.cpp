@@ -0,0 +1,100 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "LockFreeVector.hpp"
+
+BOOST_AUTO_TEST_CASE(TestSingleThreadLockFreeVector)
+{
+  static constexpr std::size_t numElem = 10000;
+  LockFreeVector<std::string, 1 << 4> vec;
+  BOOST_CHECK(vec.empty());
+  BOOST_CHECK_EQUAL(vec.push_back("0"), 0u);
+  // references stay valid while the vector grows
+  auto& first = vec[0];
+  for(std::size_t i = 1; i < numElem; ++i)
+  {
+    BOOST_CHECK_EQUAL(vec.emplace_back(std::to_string(i)), i);
+  }
+  BOOST_CHECK_EQUAL(vec.size(), numElem);
+  BOOST_CHECK_EQUAL(&first, &vec[0]);
+  for(std::size_t i = 0; i < numElem; ++i)
+  {
+    BOOST_CHECK_EQUAL(vec[i], std::to_string(i));
+    BOOST_REQUIRE(vec.tryGet(i));
+    BOOST_CHECK_EQUAL(*vec.tryGet(i), std::to_string(i));
+  }
+  std::size_t count = 0;
+  vec.for_each([&count](std::size_t i, std::string& elem){ count += elem == std::to_string(i); });
+  BOOST_CHECK_EQUAL(count, numElem);
+}
+
+BOOST_AUTO_TEST_CASE(TestLockFreeVectorDestroysElements)
+{
+  auto counter = std::make_shared<int>(0);
+  {
+    LockFreeVector<std::shared_ptr<int>> vec;
+    for(int i = 0; i < 3000; ++i)
+    {
+      vec.push_back(counter);
+    }
+    BOOST_CHECK_EQUAL(counter.use_count(), 3001);
+  }
+  BOOST_CHECK_EQUAL(counter.use_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestLockFreeVector)
+{
+  static constexpr std::size_t numThreads = 4;
+  static constexpr std::size_t numPush = 20000;
+  LockFreeVector<std::pair<std::size_t, std::size_t>, 1 << 8> vec;
+  std::atomic<bool> done = false;
+  // a reader sees every published element complete while the writers push
+  auto reader = std::async(std::launch::async, [&vec, &done](){
+    std::size_t errors = 0;
+    while(!done.load())
+    {
+      vec.for_each([&errors](std::size_t, std::pair<std::size_t, std::size_t>& elem){
+        errors += numThreads <= elem.first || numPush <= elem.second;
+      });
+    }
+    return errors;
+  });
+  std::vector<std::future<std::vector<std::size_t>>> writers;
+  for(std::size_t t = 0; t < numThreads; ++t)
+  {
+    writers.push_back(std::async(std::launch::async, [&vec, t](){
+      std::vector<std::size_t> indices;
+      for(std::size_t i = 0; i < numPush; ++i)
+      {
+        indices.push_back(vec.emplace_back(t, i));
+      }
+      return indices;
+    }));
+  }
+  std::vector<std::vector<std::size_t>> indices;
+  for(auto& fut: writers)
+  {
+    indices.push_back(fut.get());
+  }
+  done.store(true);
+  BOOST_CHECK_EQUAL(reader.get(), 0u);
+  BOOST_CHECK_EQUAL(vec.size(), numThreads * numPush);
+  std::vector<bool> seen(numThreads * numPush, false);
+  for(std::size_t t = 0; t < numThreads; ++t)
+  {
+    for(std::size_t i = 0; i < numPush; ++i)
+    {
+      auto index = indices[t][i];
+      BOOST_REQUIRE(index < seen.size());
+      BOOST_CHECK(!seen[index]);
+      seen[index] = true;
+      BOOST_CHECK(vec[index] == std::make_pair(t, i));
+    }
+  }
+}
@@ -2,6 +2,7 @@
 #define BOOST_TEST_MAIN
 
 #include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
 #include <thread>
 #include <chrono>
 #include <string>
@@ -11,9 +12,14 @@
 #include <mutex>
 #include <condition_variable>
 #include <algorithm>
+#include <memory>
 #include "MSQueue.hpp"
+#include "EpochBasedReclamation.hpp"
+#include "QuiescentStateBasedReclamation.hpp"
 
-BOOST_AUTO_TEST_CASE(TestMSQueue)
+using Reclaimers = boost::mpl::list<HazardPointerDomain<2>, EpochDomain, QuiescentStateDomain>;
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestMSQueue, Reclaimer, Reclaimers)
 {
   {
     std::promise<void> start;
@@ -25,7 +31,7 @@ BOOST_AUTO_TEST_CASE(TestMSQueue)
     static constexpr std::size_t numPushThread = 8;
     static constexpr std::size_t numPopThread = 8;
 
-    MSQueue<std::pair<int, int>> queue1;
+    MSQueue<std::pair<int, int>, Reclaimer> queue1;
     for(std::size_t i = 0; i < numPushThread; ++i)
     {
       std::promise<void> promise;
@@ -93,8 +99,8 @@ BOOST_AUTO_TEST_CASE(TestMSQueue)
     static constexpr std::size_t numPopPushThread = 4;
     static constexpr std::size_t numPopThread = 4;
 
-    MSQueue<int> queue1;
-    MSQueue<int> queue2;
+    MSQueue<int, Reclaimer> queue1;
+    MSQueue<int, Reclaimer> queue2;
     for(std::size_t i = 0; i < numPushThread; ++i)
     {
       std::promise<void> promise;
@@ -174,3 +180,210 @@ BOOST_AUTO_TEST_CASE(TestMSQueue)
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestMSQueueWithOwnHazardPointerDomain)
+{
+  {
+    static constexpr std::size_t numPush = 10000;
+    static constexpr std::size_t numThread = 4;
+    // domains have to outlive the queues
+    HazardPointerDomain<2> domain1;
+    HazardPointerDomain<2> domain2;
+    MSQueue<int> queue1(domain1);
+    MSQueue<int> queue2(domain2);
+    std::promise<void> start;
+    auto fut = start.get_future().share();
+    std::vector<std::future<void>> done;
+    for(std::size_t i = 0; i < numThread; ++i)
+    {
+      done.push_back(std::async(std::launch::async, [&queue1, &queue2, i, fut]() {
+        fut.wait();
+        for(std::size_t j = i * numPush; j < (i + 1) * numPush; ++j)
+        {
+          queue1.push(j);
+          auto p = queue1.tryPop();
+          while(!p)
+          {
+            p = queue1.tryPop();
+          }
+          queue2.push(*p);
+        }
+      }));
+    }
+    start.set_value();
+    for(auto& fut: done)
+    {
+      fut.wait();
+    }
+    std::vector<int> actuals;
+    while(auto p = queue2.tryPop())
+    {
+      actuals.push_back(*p);
+    }
+    BOOST_CHECK(!queue1.tryPop());
+    std::sort(actuals.begin(), actuals.end());
+    std::vector<int> expected;
+    for(std::size_t i = 0; i < numPush * numThread; ++i)
+    {
+      expected.push_back(i);
+    }
+    BOOST_CHECK_EQUAL_COLLECTIONS(actuals.begin(), actuals.end(), expected.begin(), expected.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestMSQueueClear, Reclaimer, Reclaimers)
+{
+  {
+    MSQueue<int, Reclaimer> queue;
+    queue.clear();
+    BOOST_CHECK(!queue.tryPop());
+    for(int i = 0; i < 100; ++i)
+    {
+      queue.push(i);
+    }
+    queue.clear();
+    BOOST_CHECK(!queue.tryPop());
+    queue.push(100);
+    auto p = queue.tryPop();
+    BOOST_CHECK(p && *p == 100);
+    BOOST_CHECK(!queue.tryPop());
+  }
+  {
+    static constexpr int numPush = 10000;
+    static constexpr int numPushThread = 2;
+    MSQueue<int, Reclaimer> queue;
+    std::promise<void> start;
+    auto fut = start.get_future().share();
+    std::atomic<bool> pushDone = false;
+    std::vector<std::future<void>> pushers;
+    for(int i = 0; i < numPushThread; ++i)
+    {
+      pushers.push_back(std::async(std::launch::async, [&queue, i, fut]() {
+        fut.wait();
+        for(int j = 0; j < numPush; ++j)
+        {
+          queue.push(i * numPush + j);
+        }
+      }));
+    }
+    auto clearer = std::async(std::launch::async, [&queue, &pushDone, fut]() {
+      fut.wait();
+      while(!pushDone.load())
+      {
+        queue.clear();
+      }
+    });
+    auto popper = std::async(std::launch::async, [&queue, &pushDone, fut]() {
+      fut.wait();
+      std::vector<int> ans;
+      while(!pushDone.load())
+      {
+        if(auto p = queue.tryPop())
+        {
+          ans.push_back(*p);
+        }
+      }
+      return ans;
+    });
+    start.set_value();
+    for(auto& f: pushers)
+    {
+      f.wait();
+    }
+    pushDone.store(true);
+    clearer.wait();
+    auto popped = popper.get();
+    std::sort(popped.begin(), popped.end());
+    BOOST_CHECK(std::adjacent_find(popped.begin(), popped.end()) == popped.end());
+    queue.clear();
+    BOOST_CHECK(!queue.tryPop());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestMSQueueWithRegisteredQuiescentThreads)
+{
+  {
+    static constexpr int numPush = 10000;
+    static constexpr int numThread = 4;
+    MSQueue<int, QuiescentStateDomain> queue;
+    std::promise<void> start;
+    auto fut = start.get_future().share();
+    std::vector<std::future<std::vector<int>>> done;
+    for(int i = 0; i < numThread; ++i)
+    {
+      done.push_back(std::async(std::launch::async, [&queue, i, fut]() {
+        QuiescentStateDomain::registerThread();
+        fut.wait();
+        std::vector<int> ans;
+        for(int j = 0; j < numPush; ++j)
+        {
+          queue.push(i * numPush + j);
+          QuiescentStateDomain::quiescentState();
+          auto p = queue.tryPop();
+          while(!p)
+          {
+            p = queue.tryPop();
+          }
+          ans.push_back(*p);
+          QuiescentStateDomain::quiescentState();
+        }
+        QuiescentStateDomain::unregisterThread();
+        return ans;
+      }));
+    }
+    start.set_value();
+    std::vector<int> actuals;
+    for(auto& f: done)
+    {
+      auto vec = f.get();
+      actuals.insert(actuals.end(), vec.begin(), vec.end());
+    }
+    std::sort(actuals.begin(), actuals.end());
+    std::vector<int> expected;
+    for(int i = 0; i < numPush * numThread; ++i)
+    {
+      expected.push_back(i);
+    }
+    BOOST_CHECK_EQUAL_COLLECTIONS(actuals.begin(), actuals.end(), expected.begin(), expected.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestMSQueueMoveOnly, Reclaimer, Reclaimers)
+{
+  {
+    MSQueue<std::unique_ptr<std::string>, Reclaimer> queue;
+    queue.push(std::make_unique<std::string>("a"));
+    queue.emplace(new std::string("b"));
+    auto p = std::make_unique<std::string>("c");
+    queue.push(std::move(p));
+    BOOST_CHECK(!p);
+    auto value = queue.tryPop();
+    BOOST_CHECK(value && *value && **value == "a");
+    std::unique_ptr<std::string> data;
+    BOOST_CHECK(queue.tryPop(data));
+    BOOST_CHECK(data && *data == "b");
+    BOOST_CHECK(queue.tryPop(data));
+    BOOST_CHECK(data && *data == "c");
+    BOOST_CHECK(!queue.tryPop(data));
+    BOOST_CHECK(!queue.tryPop());
+  }
+  {
+    // the elements left in the queue are destroyed by clear and by the destructor
+    auto counter = std::make_shared<int>(0);
+    {
+      MSQueue<std::shared_ptr<int>, Reclaimer> queue;
+      for(int i = 0; i < 10; ++i)
+      {
+        queue.push(counter);
+      }
+      queue.clear();
+      BOOST_CHECK_EQUAL(counter.use_count(), 1);
+      for(int i = 0; i < 10; ++i)
+      {
+        queue.emplace(counter);
+      }
+      BOOST_CHECK(queue.tryPop().has_value());
+      BOOST_CHECK_EQUAL(counter.use_count(), 10);
+    }
+    BOOST_CHECK_EQUAL(counter.use_count(), 1);
+  }
+}
@@ -0,0 +1,92 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <future>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include "NodePool.hpp"
+
+namespace
+{
+struct TestNode
+{
+  int mValue;
+  TestNode* mNext;
+  explicit TestNode(int value): mValue(value), mNext(nullptr) {}
+};
+}
+
+BOOST_AUTO_TEST_CASE(TestNodePoolReuse)
+{
+  static constexpr int numNodes = 10000;
+  std::vector<TestNode*> nodes;
+  for(int i = 0; i < numNodes; ++i)
+  {
+    nodes.push_back(NodePool<TestNode>::create(i));
+  }
+  std::set<TestNode*> addresses(nodes.begin(), nodes.end());
+  BOOST_CHECK_EQUAL(addresses.size(), static_cast<std::size_t>(numNodes));
+  for(int i = 0; i < numNodes; ++i)
+  {
+    BOOST_CHECK_EQUAL(nodes[i]->mValue, i);
+    NodePool<TestNode>::destroy(nodes[i]);
+  }
+  // blocks freed by the owner thread are reused by the next allocations
+  for(int i = 0; i < numNodes; ++i)
+  {
+    auto node = NodePool<TestNode>::create(i);
+    BOOST_CHECK(addresses.count(node));
+    nodes[i] = node;
+  }
+  for(auto node: nodes)
+  {
+    NodePool<TestNode>::destroy(node);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestNodePoolRemoteFree)
+{
+  static constexpr int numNodes = 10000;
+  static constexpr int numRounds = 10;
+  // nodes are allocated by one thread and freed by another one, they go back to the allocating thread in batches
+  for(int round = 0; round < numRounds; ++round)
+  {
+    auto nodes = std::async(std::launch::async, [](){
+      std::vector<TestNode*> ans;
+      for(int i = 0; i < numNodes; ++i)
+      {
+        ans.push_back(NodePool<TestNode>::create(i));
+      }
+      return ans;
+    }).get();
+    for(int i = 0; i < numNodes; ++i)
+    {
+      BOOST_CHECK_EQUAL(nodes[i]->mValue, i);
+    }
+    std::async(std::launch::async, [&nodes](){
+      for(auto node: nodes)
+      {
+        NodePool<TestNode>::destroy(node);
+      }
+    }).wait();
+  }
+  // the cache of an exited thread is adopted by a new thread together with the blocks returned to it
+  std::set<TestNode*> addresses;
+  auto nodes = std::async(std::launch::async, [](){
+    std::vector<TestNode*> ans;
+    for(int i = 0; i < numNodes; ++i)
+    {
+      ans.push_back(NodePool<TestNode>::create(i));
+    }
+    return ans;
+  }).get();
+  addresses.insert(nodes.begin(), nodes.end());
+  BOOST_CHECK_EQUAL(addresses.size(), static_cast<std::size_t>(numNodes));
+  for(auto node: nodes)
+  {
+    NodePool<TestNode>::destroy(node);
+  }
+}
@@ -0,0 +1,115 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SegmentedQueue.hpp"
+#include "EpochBasedReclamation.hpp"
+
+using Reclaimers = boost::mpl::list<HazardPointerDomain<>, EpochDomain>;
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestSingleThreadSegmentedQueue, Reclaimer, Reclaimers)
+{
+  // small segments, so that the queue moves through many of them
+  SegmentedQueue<std::string, 4, Reclaimer> queue;
+  BOOST_CHECK(queue.empty());
+  BOOST_CHECK(!queue.tryPop().has_value());
+  for(int round = 0; round < 3; ++round)
+  {
+    for(int i = 0; i < 10; ++i)
+    {
+      queue.push(std::to_string(i));
+    }
+    BOOST_CHECK(!queue.empty());
+    for(int i = 0; i < 10; ++i)
+    {
+      auto value = queue.tryPop();
+      BOOST_REQUIRE(value.has_value());
+      BOOST_CHECK_EQUAL(*value, std::to_string(i));
+    }
+    BOOST_CHECK(queue.empty());
+    BOOST_CHECK(!queue.tryPop().has_value());
+  }
+  queue.emplace(3, 'a');
+  std::string value;
+  BOOST_CHECK(queue.tryPop(value));
+  BOOST_CHECK_EQUAL(value, "aaa");
+  BOOST_CHECK(!queue.tryPop(value));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestSegmentedQueueDestroysElements, Reclaimer, Reclaimers)
+{
+  auto counter = std::make_shared<int>(0);
+  {
+    SegmentedQueue<std::shared_ptr<int>, 4, Reclaimer> queue;
+    for(int i = 0; i < 10; ++i)
+    {
+      queue.push(counter);
+    }
+    // the first segment is drained and retired
+    for(int i = 0; i < 5; ++i)
+    {
+      BOOST_CHECK(queue.tryPop().has_value());
+    }
+    BOOST_CHECK_EQUAL(counter.use_count(), 6);
+  }
+  BOOST_CHECK_EQUAL(counter.use_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(TestSegmentedQueue, Reclaimer, Reclaimers)
+{
+  static constexpr int numPush = 20000;
+  static constexpr int numPushThread = 4;
+  static constexpr int numPopThread = 4;
+  SegmentedQueue<std::unique_ptr<std::pair<int, int>>, 8, Reclaimer> queue;
+  std::vector<std::future<void>> pushDone;
+  std::vector<std::future<std::vector<std::pair<int, int>>>> popDone;
+  for(int i = 0; i < numPushThread; ++i)
+  {
+    pushDone.push_back(std::async(std::launch::async, [&queue, i](){
+      for(int j = 0; j < numPush; ++j)
+      {
+        queue.push(std::make_unique<std::pair<int, int>>(i, j));
+      }
+    }));
+  }
+  for(int i = 0; i < numPopThread; ++i)
+  {
+    popDone.push_back(std::async(std::launch::async, [&queue](){
+      std::vector<std::pair<int, int>> ans;
+      std::unique_ptr<std::pair<int, int>> p;
+      while(ans.size() < numPush * numPushThread / numPopThread)
+      {
+        if(queue.tryPop(p))
+        {
+          ans.push_back(*p);
+        }
+      }
+      return ans;
+    }));
+  }
+  for(auto& fut: pushDone)
+  {
+    fut.get();
+  }
+  std::vector<std::vector<bool>> seen(numPushThread, std::vector<bool>(numPush, false));
+  for(auto& fut: popDone)
+  {
+    auto values = fut.get();
+    // the elements of a producer are popped by a consumer in the order they were pushed
+    std::vector<int> last(numPushThread, -1);
+    for(auto [i, j]: values)
+    {
+      BOOST_REQUIRE(0 <= i && i < numPushThread && 0 <= j && j < numPush);
+      BOOST_CHECK(last[i] < j);
+      last[i] = j;
+      BOOST_CHECK(!seen[i][j]);
+      seen[i][j] = true;
+    }
+  }
+  BOOST_CHECK(queue.empty());
+}
@@ -0,0 +1,74 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <future>
+#include <vector>
+#include "ShardedCounter.hpp"
+
+BOOST_AUTO_TEST_CASE(TestShardedCounter)
+{
+  static constexpr std::size_t numThreads = 8;
+  static constexpr int numAdd = 10000;
+  ShardedCounter counter;
+  BOOST_CHECK_EQUAL(counter.load(), 0);
+  std::vector<std::future<std::size_t>> done;
+  for(std::size_t i = 0; i < numThreads; ++i)
+  {
+    done.push_back(std::async(std::launch::async, [&counter](){
+      std::size_t sampled = 0;
+      for(int j = 0; j < numAdd; ++j)
+      {
+        sampled += counter.addAndSample(1) ? 1 : 0;
+      }
+      counter.add(-numAdd / 2);
+      return sampled;
+    }));
+  }
+  for(auto& fut: done)
+  {
+    auto sampled = fut.get();
+    BOOST_CHECK(0 < sampled && sampled < static_cast<std::size_t>(numAdd));
+  }
+  BOOST_CHECK_EQUAL(counter.load(), static_cast<std::int64_t>(numThreads * numAdd / 2));
+  // the sum of the shards may be negative for a moment, load() never is
+  counter.add(-2 * static_cast<std::int64_t>(numThreads * numAdd));
+  BOOST_CHECK_EQUAL(counter.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedCounterSampling)
+{
+  static constexpr std::size_t numThreads = 4;
+  static constexpr int numAdd = 10000;
+  ShardedCounter counter;
+  // threads which only decrement keep their shards negative, they sample as rarely as the ones which increment
+  std::vector<std::future<std::size_t>> done;
+  for(std::size_t i = 0; i < numThreads; ++i)
+  {
+    done.push_back(std::async(std::launch::async, [&counter, i](){
+      std::size_t sampled = 0;
+      for(int j = 0; j < numAdd; ++j)
+      {
+        sampled += counter.addAndSample(i % 2 ? -1 : 1) ? 1 : 0;
+      }
+      return sampled;
+    }));
+  }
+  // threads may share a shard, so a thread gets about its share of the samples of the shard
+  std::size_t total = 0;
+  for(auto& fut: done)
+  {
+    auto sampled = fut.get();
+    BOOST_CHECK(sampled <= 2 * numAdd / ShardedCounter::sSampleInterval);
+    total += sampled;
+  }
+  BOOST_CHECK(0 < total);
+  // a single thread which keeps a small shard samples rarely too
+  std::size_t sampled = 0;
+  for(int j = 0; j < numAdd; ++j)
+  {
+    sampled += counter.addAndSample(j % 2 ? -1 : 1) ? 1 : 0;
+  }
+  BOOST_CHECK(sampled <= numAdd / ShardedCounter::sSampleInterval + 1);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include "LockFreeExtendibleBucket.hpp"
+
+// Append only vector without locks. push_back reserves an index with a single fetch_add on the size,
+// constructs the element in its slot and publishes it by the flag of the slot.
+// Slots are never moved, so references to elements stay valid until the vector is destroyed.
+// Elements are stored in leaves of BaseArraySize slots allocated by LeafAllocator, see LockFreeExtendibleBucket.
+template <typename T, std::size_t BaseArraySize = 1 << 10, typename LeafAllocator = NewLeafAllocator>
+class LockFreeVector
+{
+private:
+  struct Slot
+  {
+    std::atomic<bool> mPublished;
+    alignas(T) unsigned char mStorage[sizeof(T)];
+    T* get() noexcept { return std::launder(reinterpret_cast<T*>(mStorage)); }
+  };
+  struct SlotInitializer
+  {
+    void operator()(Slot& slot)
+    {
+      slot.mPublished.store(false, std::memory_order_relaxed);
+    }
+  };
+  LockFreeExtendibleBucket<Slot, BaseArraySize, SlotInitializer, LeafAllocator> mSlots;
+  std::atomic<std::size_t> mSize; // the number of reserved slots, some of them may not be published yet
+  Slot& getSlot(std::size_t i)
+  {
+    // the directory has to cover i before the slot is accessed, any thread may extend it
+    while(mSlots.size() <= i)
+    {
+      mSlots.extend();
+    }
+    return mSlots[i];
+  }
+public:
+  LockFreeVector(): mSlots(BaseArraySize), mSize(0) {}
+  ~LockFreeVector()
+  {
+    // a slot beyond the directory was reserved by a push_back which failed to extend it
+    auto size = std::min(mSize.load(std::memory_order_acquire), mSlots.size());
+    for(std::size_t i = 0; i < size; ++i)
+    {
+      auto& slot = mSlots[i];
+      if(slot.mPublished.load(std::memory_order_acquire))
+      {
+        slot.get()->~T();
+      }
+    }
+  }
+  LockFreeVector(const LockFreeVector&) = delete;
+  LockFreeVector(LockFreeVector&&) = delete;
+  LockFreeVector& operator=(const LockFreeVector&) = delete;
+  LockFreeVector& operator=(LockFreeVector&&) = delete;
+  // constructs an element at the end and returns its index. If the constructor throws, the reserved slot is never published.
+  template <typename... Args>
+  std::size_t emplace_back(Args&&... args)
+  {
+    auto i = mSize.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = getSlot(i);
+    new(slot.mStorage) T(std::forward<Args>(args)...);
+    slot.mPublished.store(true, std::memory_order_release);
+    return i;
+  }
+  std::size_t push_back(const T& value)
+  {
+    return emplace_back(value);
+  }
+  std::size_t push_back(T&& value)
+  {
+    return emplace_back(std::move(value));
+  }
+  // the element at i if it has been published, otherwise nullptr. i has to be less than size().
+  T* tryGet(std::size_t i)
+  {
+    assert(i < size());
+    auto& slot = getSlot(i);
+    return slot.mPublished.load(std::memory_order_acquire) ? slot.get() : nullptr;
+  }
+  // i has to be an index returned by push_back or emplace_back in this thread, or an element seen published by tryGet or for_each.
+  T& operator[](std::size_t i)
+  {
+    assert(i < size() && mSlots[i].mPublished.load(std::memory_order_relaxed));
+    return *mSlots[i].get();
+  }
+  // calls fn(index, T&) for the published elements in [0, size()) in index order,
+  // elements which are being constructed by other threads are skipped.
+  template <typename F>
+  void for_each(F&& fn)
+  {
+    auto size = mSize.load(std::memory_order_acquire);
+    for(std::size_t i = 0; i < size; ++i)
+    {
+      if(auto elem = tryGet(i))
+      {
+        fn(i, *elem);
+      }
+    }
+  }
+  // the number of reserved slots, which includes the elements still being constructed
+  std::size_t size() const noexcept { return mSize.load(std::memory_order_acquire); }
+  bool empty() const noexcept { return size() == 0; }
+};
@@ -1,16 +1,89 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
 #include <functional>
+#include <array>
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SANITIZE_THREAD__)
+#define CONCURRENCY_SANDBOX_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define CONCURRENCY_SANDBOX_TSAN 1
+#endif
+#endif
 
 namespace Detail
 {
+// std::atomic_thread_fence is not supported by ThreadSanitizer (gcc rejects it with -Werror=tsan),
+// a sequentially consistent read-modify-write is a full barrier on the platforms we test on.
+inline void seqCstFence() noexcept
+{
+#ifdef CONCURRENCY_SANDBOX_TSAN
+  static std::atomic<int> sDummy(0);
+  sDummy.fetch_add(0, std::memory_order_seq_cst);
+#else
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+#endif
+}
+// Asymmetric fence: readers pay only a compiler barrier when they publish a hazard pointer,
+// and the reclaimer forces a memory barrier on every running thread of the process by membarrier(2) before it scans hazard pointers.
+// Falls back to sequentially consistent publication when the syscall is not available (non linux or kernel < 4.14).
+// Define CONCURRENCY_SANDBOX_NO_ASYMMETRIC_FENCE to always use the fallback.
+class AsymmetricFence
+{
+private:
+  static bool registerProcess() noexcept
+  {
+#if defined(__linux__) && defined(__NR_membarrier) && !defined(CONCURRENCY_SANDBOX_NO_ASYMMETRIC_FENCE)
+    auto commands = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0);
+    if(commands < 0 || !(commands & MEMBARRIER_CMD_PRIVATE_EXPEDITED))
+    {
+      return false;
+    }
+    return syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+#else
+    return false;
+#endif
+  }
+public:
+  static bool isAvailable() noexcept
+  {
+    // function local static so that readers and reclaimers never disagree on the mode, even during static initialization.
+    static const bool sAvailable = registerProcess();
+    return sAvailable;
+  }
+  static void light() noexcept
+  {
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+  }
+  static void heavy() noexcept
+  {
+#if defined(__linux__) && defined(__NR_membarrier)
+    syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+#endif
+  }
+};
 struct HazardPointerListNode
 {
   std::atomic<void*> mPointer;
+  std::atomic<bool> mInUse;
   HazardPointerListNode* mNext;
-  HazardPointerListNode() noexcept: mPointer(nullptr), mNext(nullptr) {}
+  HazardPointerListNode() noexcept: mPointer(nullptr), mInUse(true), mNext(nullptr) {}
 };
 class HazardPointerList
 {
@@ -50,21 +123,112 @@ public:
     mSize.fetch_add(1, std::memory_order_relaxed);
     while(!mHead.compare_exchange_weak(node->mNext, node, std::memory_order_seq_cst, std::memory_order_relaxed));
   }
+  // reuses a node released by an exited thread if any, so that the list does not grow with the number of threads ever created.
+  HazardPointerListNode* acquire()
+  {
+    for(auto cur = mHead.load(std::memory_order_seq_cst); cur; cur = cur->mNext)
+    {
+      bool expected = false;
+      if(!cur->mInUse.load(std::memory_order_relaxed) &&
+         cur->mInUse.compare_exchange_strong(expected, true, std::memory_order_acquire, std::memory_order_relaxed))
+      {
+        return cur;
+      }
+    }
+    auto node = std::make_unique<HazardPointerListNode>();
+    append(node.get());
+    return node.release();
+  }
+  static void release(HazardPointerListNode* node) noexcept
+  {
+    node->mPointer.store(nullptr, std::memory_order_release);
+    node->mInUse.store(false, std::memory_order_release);
+  }
   int size() const noexcept
   {
     return mSize.load(std::memory_order_relaxed);
   }
 };
+// reclamation counters of a thread, each counter is written only by the owner thread and read by HazardPointerDomain::getStats.
+// Slots are padded to a cache line so that threads updating their own counters do not share cache lines.
+struct alignas(64) ReclamationCounters
+{
+  std::atomic<std::uint64_t> mRetired;
+  std::atomic<std::uint64_t> mFreed;
+  std::atomic<std::uint64_t> mScans;
+  std::atomic<std::uint64_t> mScannedNodes;
+  std::atomic<std::uint64_t> mRetiredBytes;
+  std::atomic<std::uint64_t> mFreedBytes;
+  std::atomic<std::uint64_t> mPending; // the size of the local delete list of the owner
+  std::atomic<bool> mInUse;
+  ReclamationCounters* mNext;
+  ReclamationCounters() noexcept
+    : mRetired(0), mFreed(0), mScans(0), mScannedNodes(0), mRetiredBytes(0), mFreedBytes(0), mPending(0), mInUse(true), mNext(nullptr) {}
+  static void increment(std::atomic<std::uint64_t>& counter, std::uint64_t n = 1) noexcept
+  {
+    // single writer, so a plain load and store is enough and cheaper than fetch_add
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+};
+class ReclamationCountersList
+{
+private:
+  std::atomic<ReclamationCounters*> mHead;
+public:
+  ReclamationCountersList() noexcept: mHead(nullptr) {}
+  ~ReclamationCountersList()
+  {
+    auto cur = mHead.load(std::memory_order_acquire);
+    while(cur)
+    {
+      auto next = cur->mNext;
+      delete cur;
+      cur = next;
+    }
+  }
+  // counters of exited threads are reused, they are cumulative so that the totals do not drop when a thread exits.
+  ReclamationCounters* acquire()
+  {
+    for(auto cur = mHead.load(std::memory_order_acquire); cur; cur = cur->mNext)
+    {
+      bool expected = false;
+      if(!cur->mInUse.load(std::memory_order_relaxed) &&
+         cur->mInUse.compare_exchange_strong(expected, true, std::memory_order_acquire, std::memory_order_relaxed))
+      {
+        return cur;
+      }
+    }
+    auto node = new ReclamationCounters();
+    node->mNext = mHead.load(std::memory_order_relaxed);
+    while(!mHead.compare_exchange_weak(node->mNext, node, std::memory_order_release, std::memory_order_relaxed));
+    return node;
+  }
+  static void release(ReclamationCounters* counters) noexcept
+  {
+    counters->mPending.store(0, std::memory_order_relaxed);
+    counters->mInUse.store(false, std::memory_order_release);
+  }
+  ReclamationCounters* getHead() const noexcept
+  {
+    return mHead.load(std::memory_order_acquire);
+  }
+};
 struct DeleteListNode
 {
   void* mData;
   DeleteListNode* mNext;
   std::function<void(void*)> mDeleter;
+  std::size_t mBytes; // 0 if the size was not given at retire
   template <typename Deleter>
-  explicit DeleteListNode(void* data, Deleter&& deleter): mData(data), mNext(nullptr), mDeleter(std::forward<Deleter>(deleter)) {}
+  explicit DeleteListNode(void* data, Deleter&& deleter, std::size_t bytes = 0)
+    : mData(data), mNext(nullptr), mDeleter(std::forward<Deleter>(deleter)), mBytes(bytes) {}
   ~DeleteListNode()
   {
-    mDeleter(mData);
+    // the deleter is empty if the node was never retired, see makeDeleteListChain
+    if(mDeleter)
+    {
+      mDeleter(mData);
+    }
   }
 };
 class GlobalDeleteList
@@ -122,9 +286,9 @@ public:
     }
   }
   template <typename Deleter>
-  void append(void* data, Deleter&& deleter)
+  void append(void* data, Deleter&& deleter, std::size_t bytes = 0)
   {
-    auto node = std::make_unique<DeleteListNode>(data, std::forward<Deleter>(deleter));
+    auto node = std::make_unique<DeleteListNode>(data, std::forward<Deleter>(deleter), bytes);
     append(node.get());
     node.release();
   }
@@ -134,6 +298,13 @@ public:
     node->mNext = mHead;
     mHead = node;
   }
+  // appends the chain [head, last] of size nodes
+  void append(DeleteListNode* head, DeleteListNode* last, int size) noexcept
+  {
+    mSize += size;
+    last->mNext = mHead;
+    mHead = head;
+  }
   DeleteListNode* resetHead() noexcept
   {
     auto ans = mHead;
@@ -146,98 +317,363 @@ public:
     return mSize;
   }
 };
+struct DeleteListChain
+{
+  DeleteListNode* mHead;
+  DeleteListNode* mTail;
+  int mSize;
+};
+// makes the chain of DeleteListNode for the nodes in [first, last) which share the deleter, see retireBatch of the domains.
+// If an allocation throws, the DeleteListNodes made so far are freed without calling the deleter, so none of the nodes is retired.
+template <typename InputIterator>
+DeleteListChain makeDeleteListChain(InputIterator first, InputIterator last, const std::function<void(void*)>& deleter)
+{
+  DeleteListChain chain{nullptr, nullptr, 0};
+  try
+  {
+    for(; first != last; ++first)
+    {
+      auto node = new DeleteListNode(*first, deleter);
+      node->mNext = chain.mHead;
+      chain.mHead = node;
+      if(!chain.mTail)
+      {
+        chain.mTail = node;
+      }
+      ++chain.mSize;
+    }
+  }
+  catch(...)
+  {
+    while(chain.mHead)
+    {
+      auto next = chain.mHead->mNext;
+      chain.mHead->mDeleter = nullptr;
+      delete chain.mHead;
+      chain.mHead = next;
+    }
+    throw;
+  }
+  return chain;
 }
+}
+
+class HazardPointerHolder;
 
+// A domain owns a set of hazard pointers and retired nodes. Containers which share a domain scan each other's hazard pointers and retired nodes,
+// so unrelated hot containers should be given their own domain. defaultDomain() is shared by containers which are not given one.
+// A domain has to outlive the containers which use it.
 template <std::size_t HazardPointerNumPerThread = 1>
 class HazardPointerDomain
 {
 private:
-  class HazardPointerOwner
+  struct State
+  {
+    Detail::HazardPointerList mHazardPointerList;
+    Detail::GlobalDeleteList mGlobalDeleteList;
+    Detail::ReclamationCountersList mReclamationCountersList;
+    std::atomic<bool> mAlive;
+    std::atomic<std::size_t> mMaxPendingPerThread;
+    State() noexcept: mAlive(true), mMaxPendingPerThread(std::numeric_limits<std::size_t>::max()) {}
+  };
+  // hazard pointers and retired nodes of a thread for a domain.
+  // The state is shared with the thread so that nodes retired by the thread are reclaimed even if the domain is destructed first.
+  class LocalState
   {
-  private:
-    std::atomic<void*>* mPointer;
   public:
-    HazardPointerOwner(): mPointer(nullptr)
+    std::shared_ptr<State> mState;
+    std::array<Detail::HazardPointerListNode*, HazardPointerNumPerThread> mHazardPointers;
+    Detail::ReclamationCounters* mCounters;
+    Detail::LocalDeleteList mLocalDeleteList; // have to be declared after mState because the destructor moves the nodes to the global list of mState
+    explicit LocalState(std::shared_ptr<State> state)
+      : mState(std::move(state))
+      , mHazardPointers{}
+      , mCounters(mState->mReclamationCountersList.acquire())
+      , mLocalDeleteList(mState->mGlobalDeleteList)
     {
-      auto node = std::make_unique<Detail::HazardPointerListNode>();
-      mPointer = &node->mPointer;
-      sHazardPointerList.append(node.release());
+      for(auto& hp: mHazardPointers)
+      {
+        hp = mState->mHazardPointerList.acquire();
+      }
     }
-    ~HazardPointerOwner()
+    ~LocalState()
     {
-      mPointer->store(nullptr, std::memory_order_seq_cst);
+      for(auto hp: mHazardPointers)
+      {
+        Detail::HazardPointerList::release(hp);
+      }
+      Detail::ReclamationCountersList::release(mCounters);
     }
-    std::atomic<void*>& getPointer() noexcept
+  };
+  class LocalStateCache
+  {
+  public:
+    std::vector<std::unique_ptr<LocalState>> mLocalStates;
+    ~LocalStateCache()
     {
-      return *mPointer;
+      sLastState = nullptr;
+      sLastLocalState = nullptr;
     }
   };
-  static Detail::HazardPointerList sHazardPointerList;
-  // TODO: global delete list have to be destructed after local delete list because the destructor of local delete list moves its nodes to the global list. We cannot delete the nodes in the local list in general because other threads may be still using the node.
-  static Detail::GlobalDeleteList sGlobalDeleteList;
-  static thread_local Detail::LocalDeleteList sLocalDeleteList;
-  static thread_local HazardPointerOwner sHazardPointerOwner[HazardPointerNumPerThread];
-  HazardPointerDomain() = delete;
-  HazardPointerDomain(const HazardPointerDomain&) = delete;
-  HazardPointerDomain(HazardPointerDomain&&) = delete;
-  HazardPointerDomain& operator=(const HazardPointerDomain&) = delete;
-  HazardPointerDomain& operator=(HazardPointerDomain&&) = delete;
-  ~HazardPointerDomain() = delete;
-  template <typename Deleter>
-  static void appendToLocalDeleteList(void* data, Deleter&& deleter) { sLocalDeleteList.append(data, std::forward<Deleter>(deleter)); }
-public:
-  static std::atomic<void*>& getHazardPointerForCurrentThread(std::size_t i = 0) noexcept { return sHazardPointerOwner[i].getPointer(); }
-  template <typename Deleter>
-  static void retire(void* data, Deleter&& deleter)
+  static thread_local LocalStateCache sLocalStateCache;
+  // most recently used entry of sLocalStateCache. They are trivially constructible, so reading them does not need the initialization check.
+  static thread_local State* sLastState;
+  static thread_local LocalState* sLastLocalState;
+  std::shared_ptr<State> mState;
+  std::thread mReclaimerThread;
+  std::mutex mReclaimerMutex;
+  std::condition_variable mReclaimerCondition;
+  bool mReclaimerStopRequested = false;
+  LocalState& getLocalState()
   {
-    appendToLocalDeleteList(data, deleter);
-    if(2 * sHazardPointerList.size() < sLocalDeleteList.size())
+    if(sLastState == mState.get())
     {
-      tryDeallocateLocalList();
+      return *sLastLocalState;
     }
+    return getLocalStateSlow();
   }
-  static void tryDeallocateLocalList()
+  LocalState& getLocalStateSlow()
   {
-    // we do not have to collect nodes in the global list right away.
-    if(sGlobalDeleteList.loadHead(std::memory_order_relaxed))
+    auto& localStates = sLocalStateCache.mLocalStates;
+    // forget the domains which have been destructed
+    localStates.erase(
+      std::remove_if(localStates.begin(), localStates.end(), [](auto& localState){ return !localState->mState->mAlive.load(std::memory_order_relaxed); }),
+      localStates.end());
+    auto it = std::find_if(localStates.begin(), localStates.end(), [this](auto& localState){ return localState->mState == mState; });
+    if(it == localStates.end())
     {
-      auto globalHead = sGlobalDeleteList.resetHead();
-      if(globalHead)
-      {
-        auto cur = globalHead;
-        while(cur)
-        {
-          auto next = cur->mNext;
-          sLocalDeleteList.append(cur);
-          cur = next;
-        }
-      }
+      localStates.push_back(std::make_unique<LocalState>(mState));
+      it = std::prev(localStates.end());
+    }
+    sLastState = mState.get();
+    sLastLocalState = it->get();
+    return **it;
+  }
+  // deletes the nodes of the list which are not protected by any hazard pointer and appends the rest to survivors.
+  void scan(Detail::DeleteListNode* cur, Detail::LocalDeleteList& survivors, Detail::ReclamationCounters& counters)
+  {
+    std::uint64_t scanned = 0;
+    std::uint64_t freed = 0;
+    std::uint64_t freedBytes = 0;
+    if(Detail::AsymmetricFence::isAvailable())
+    {
+      // make hazard pointers published by the light path of HazardPointerHolder::store visible
+      Detail::AsymmetricFence::heavy();
     }
-    auto arr = sHazardPointerList.getPointers();
-    auto cur = sLocalDeleteList.resetHead();
+    auto arr = mState->mHazardPointerList.getPointers();
     while(cur)
     {
       auto next = cur->mNext;
+      ++scanned;
       if(std::find(arr.begin(), arr.end(), cur->mData) == arr.end())
       {
+        ++freed;
+        freedBytes += cur->mBytes;
         delete cur;
       }
       else
       {
-        sLocalDeleteList.append(cur);
+        survivors.append(cur);
       }
       cur = next;
     }
+    Detail::ReclamationCounters::increment(counters.mScans);
+    Detail::ReclamationCounters::increment(counters.mScannedNodes, scanned);
+    Detail::ReclamationCounters::increment(counters.mFreed, freed);
+    Detail::ReclamationCounters::increment(counters.mFreedBytes, freedBytes);
+  }
+  void onRetired(LocalState& localState, std::size_t num, std::size_t bytes)
+  {
+    auto& counters = *localState.mCounters;
+    Detail::ReclamationCounters::increment(counters.mRetired, num);
+    Detail::ReclamationCounters::increment(counters.mRetiredBytes, bytes);
+    auto pending = static_cast<std::size_t>(localState.mLocalDeleteList.size());
+    counters.mPending.store(pending, std::memory_order_relaxed);
+    if(static_cast<std::size_t>(2 * mState->mHazardPointerList.size()) < pending || mState->mMaxPendingPerThread.load(std::memory_order_relaxed) < pending)
+    {
+      tryDeallocateLocalList();
+    }
+  }
+  void reclaimGlobalList(Detail::ReclamationCounters& counters)
+  {
+    auto head = mState->mGlobalDeleteList.resetHead();
+    if(head)
+    {
+      // the destructor moves the nodes which are still protected back to the global list
+      Detail::LocalDeleteList survivors(mState->mGlobalDeleteList);
+      scan(head, survivors, counters);
+    }
+  }
+public:
+  using Holder = HazardPointerHolder;
+  // nodes do not need any per node state for this domain, see also IntervalDomain::NodeBase.
+  struct NodeBase {};
+  HazardPointerDomain(): mState(std::make_shared<State>()) {}
+  HazardPointerDomain(const HazardPointerDomain&) = delete;
+  HazardPointerDomain(HazardPointerDomain&&) = delete;
+  HazardPointerDomain& operator=(const HazardPointerDomain&) = delete;
+  HazardPointerDomain& operator=(HazardPointerDomain&&) = delete;
+  ~HazardPointerDomain()
+  {
+    stopBackgroundReclamation();
+    // no container uses this domain anymore, so the nodes on the global list are not referred by any thread.
+    mState->mAlive.store(false, std::memory_order_relaxed);
+    auto cur = mState->mGlobalDeleteList.resetHead();
+    while(cur)
+    {
+      auto next = cur->mNext;
+      delete cur;
+      cur = next;
+    }
+    if(sLastState == mState.get())
+    {
+      sLastState = nullptr;
+      sLastLocalState = nullptr;
+    }
+  }
+  static HazardPointerDomain& defaultDomain()
+  {
+    static HazardPointerDomain sDomain;
+    return sDomain;
+  }
+  std::atomic<void*>& getHazardPointerForCurrentThread(std::size_t i = 0) { return getLocalState().mHazardPointers[i]->mPointer; }
+  Holder makeHolder(std::size_t i = 0);
+  struct Stats
+  {
+    std::uint64_t mRetired;
+    std::uint64_t mFreed;
+    std::uint64_t mScans;
+    double mAverageScanLength; // the average number of nodes examined by a scan
+    std::vector<std::uint64_t> mPendingPerThread; // the local delete lists of the live threads
+    std::uint64_t mPendingGlobal; // nodes left by exited threads and nodes which were protected at the last background scan
+    std::uint64_t mPendingBytes; // only counts nodes retired with a size
+  };
+  // The counters are read without synchronizing with the threads which update them, so the numbers are approximate while threads retire nodes.
+  Stats getStats() const
+  {
+    Stats stats{};
+    std::uint64_t scannedNodes = 0;
+    std::uint64_t pendingLocal = 0;
+    std::uint64_t retiredBytes = 0;
+    std::uint64_t freedBytes = 0;
+    for(auto cur = mState->mReclamationCountersList.getHead(); cur; cur = cur->mNext)
+    {
+      stats.mRetired += cur->mRetired.load(std::memory_order_relaxed);
+      stats.mFreed += cur->mFreed.load(std::memory_order_relaxed);
+      stats.mScans += cur->mScans.load(std::memory_order_relaxed);
+      scannedNodes += cur->mScannedNodes.load(std::memory_order_relaxed);
+      retiredBytes += cur->mRetiredBytes.load(std::memory_order_relaxed);
+      freedBytes += cur->mFreedBytes.load(std::memory_order_relaxed);
+      if(cur->mInUse.load(std::memory_order_relaxed))
+      {
+        auto pending = cur->mPending.load(std::memory_order_relaxed);
+        stats.mPendingPerThread.push_back(pending);
+        pendingLocal += pending;
+      }
+    }
+    stats.mAverageScanLength = stats.mScans ? static_cast<double>(scannedNodes) / stats.mScans : 0.0;
+    // every node which is retired but neither freed nor on a local list is on the global list
+    auto pending = stats.mRetired > stats.mFreed ? stats.mRetired - stats.mFreed : 0;
+    stats.mPendingGlobal = pending > pendingLocal ? pending - pendingLocal : 0;
+    stats.mPendingBytes = retiredBytes > freedBytes ? retiredBytes - freedBytes : 0;
+    return stats;
+  }
+  // limits the number of retired nodes a thread keeps before it scans, the default is 2 * (the number of hazard pointers).
+  // After a scan a thread may still keep the nodes protected by hazard pointers, so a limit smaller than the number of hazard pointers makes every retire scan.
+  void setMaxPendingPerThread(std::size_t maxPending) noexcept
+  {
+    mState->mMaxPendingPerThread.store(maxPending, std::memory_order_relaxed);
+  }
+  std::size_t getMaxPendingPerThread() const noexcept
+  {
+    return mState->mMaxPendingPerThread.load(std::memory_order_relaxed);
+  }
+  // bytes is only used for getStats, it can be omitted if the pending bytes are not of interest.
+  template <typename Deleter>
+  void retire(void* data, Deleter&& deleter, std::size_t bytes = 0)
+  {
+    auto& localState = getLocalState();
+    localState.mLocalDeleteList.append(data, std::forward<Deleter>(deleter), bytes);
+    onRetired(localState, 1, bytes);
+  }
+  // retires the nodes pointed by the iterators in [first, last) with the same deleter, none of them is retired if an allocation throws.
+  // The nodes are linked to the local list at once, so the threshold is checked and the list is scanned at most once for the whole range.
+  template <typename InputIterator, typename Deleter>
+  void retireBatch(InputIterator first, InputIterator last, Deleter&& deleter)
+  {
+    if(first == last)
+    {
+      return;
+    }
+    std::function<void(void*)> f(std::forward<Deleter>(deleter));
+    auto& localState = getLocalState();
+    auto chain = Detail::makeDeleteListChain(first, last, f);
+    localState.mLocalDeleteList.append(chain.mHead, chain.mTail, chain.mSize);
+    onRetired(localState, chain.mSize, 0);
+  }
+  void tryDeallocateLocalList()
+  {
+    auto& localState = getLocalState();
+    auto& localDeleteList = localState.mLocalDeleteList;
+    auto& globalDeleteList = mState->mGlobalDeleteList;
+    // we do not have to collect nodes in the global list right away.
+    if(globalDeleteList.loadHead(std::memory_order_relaxed))
+    {
+      auto cur = globalDeleteList.resetHead();
+      while(cur)
+      {
+        auto next = cur->mNext;
+        localDeleteList.append(cur);
+        cur = next;
+      }
+    }
+    scan(localDeleteList.resetHead(), localDeleteList, *localState.mCounters);
+    localState.mCounters->mPending.store(localDeleteList.size(), std::memory_order_relaxed);
+  }
+  // Nodes left by exited threads are only collected when another thread scans,
+  // the background reclaimer scans them every interval so that they do not stay forever when no thread retires anymore.
+  // The reclaimer is stopped by stopBackgroundReclamation or the destructor.
+  void startBackgroundReclamation(std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+  {
+    std::lock_guard<std::mutex> lock(mReclaimerMutex);
+    if(mReclaimerThread.joinable())
+    {
+      return;
+    }
+    mReclaimerStopRequested = false;
+    mReclaimerThread = std::thread([this, interval]() {
+      auto counters = mState->mReclamationCountersList.acquire();
+      std::unique_lock<std::mutex> lk(mReclaimerMutex);
+      while(!mReclaimerCondition.wait_for(lk, interval, [this](){ return mReclaimerStopRequested; }))
+      {
+        lk.unlock();
+        reclaimGlobalList(*counters);
+        lk.lock();
+      }
+      Detail::ReclamationCountersList::release(counters);
+    });
+  }
+  void stopBackgroundReclamation()
+  {
+    std::thread thread;
+    {
+      std::lock_guard<std::mutex> lock(mReclaimerMutex);
+      mReclaimerStopRequested = true;
+      thread = std::move(mReclaimerThread);
+    }
+    mReclaimerCondition.notify_all();
+    if(thread.joinable())
+    {
+      thread.join();
+    }
   }
 };
 template <std::size_t N>
-Detail::HazardPointerList HazardPointerDomain<N>::sHazardPointerList;
-template <std::size_t N>
-Detail::GlobalDeleteList HazardPointerDomain<N>::sGlobalDeleteList;
+thread_local typename HazardPointerDomain<N>::LocalStateCache HazardPointerDomain<N>::sLocalStateCache;
 template <std::size_t N>
-thread_local Detail::LocalDeleteList HazardPointerDomain<N>::sLocalDeleteList(sGlobalDeleteList);
+thread_local typename HazardPointerDomain<N>::State* HazardPointerDomain<N>::sLastState = nullptr;
 template <std::size_t N>
-thread_local typename HazardPointerDomain<N>::HazardPointerOwner HazardPointerDomain<N>::sHazardPointerOwner[N];
+thread_local typename HazardPointerDomain<N>::LocalState* HazardPointerDomain<N>::sLastLocalState = nullptr;
 
 class HazardPointerHolder
 {
@@ -266,11 +702,20 @@ public:
   }
   void store(void* pointer) noexcept
   {
-    mHazardPointer->store(pointer, std::memory_order_seq_cst);
+    if(Detail::AsymmetricFence::isAvailable())
+    {
+      mHazardPointer->store(pointer, std::memory_order_release);
+      Detail::AsymmetricFence::light();
+    }
+    else
+    {
+      mHazardPointer->store(pointer, std::memory_order_seq_cst);
+    }
   }
   void release() noexcept
   {
-    mHazardPointer->store(nullptr, std::memory_order_seq_cst);
+    // clearing a hazard pointer only has to be ordered after the reads of the protected object.
+    mHazardPointer->store(nullptr, std::memory_order_release);
   }
   void swap(HazardPointerHolder& other)
   {
@@ -284,6 +729,12 @@ inline void swap(HazardPointerHolder& x, HazardPointerHolder& y)
   x.swap(y);
 }
 
+template <std::size_t N>
+HazardPointerHolder HazardPointerDomain<N>::makeHolder(std::size_t i)
+{
+  return HazardPointerHolder(getHazardPointerForCurrentThread(i));
+}
+
 template <typename T>
 T* claimPointer(std::atomic<T*>& pointer, HazardPointerHolder& holder)
 {
@@ -297,3 +748,26 @@ T* claimPointer(std::atomic<T*>& pointer, HazardPointerHolder& holder)
   while (p != q);
   return p;
 }
+
+// MarkablePointer is expected to have the same interface as AtomicMarkablePointer
+template <typename MarkablePointer>
+auto claimMarkablePointer(MarkablePointer& markablePointer, HazardPointerHolder& holder, bool* mark = nullptr)
+{
+  decltype(markablePointer.load().first) p, q;
+  bool m;
+  do
+  {
+    auto r1 = markablePointer.load(std::memory_order_seq_cst);
+    holder.store(r1.first);
+    auto r2 = markablePointer.load(std::memory_order_seq_cst);
+    p = r1.first;
+    q = r2.first;
+    m = r2.second;
+  }
+  while(p != q);
+  if(mark)
+  {
+    *mark = m;
+  }
+  return p;
+}
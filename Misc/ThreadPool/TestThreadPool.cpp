@@ -32,10 +32,28 @@ BOOST_AUTO_TEST_CASE(TestThreadPool)
   BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), actual.begin(), actual.end());
 }
 
-template <typename T>
+BOOST_AUTO_TEST_CASE(TestThreadPoolQuiescentWorkers)
+{
+  // the registration with QuiescentStateDomain is a pool option, independent of the local queue
+  auto isRegistered = []{ return QuiescentStateDomain::isRegistered(); };
+  {
+    ThreadPool<LocalWorkQueue, true> pool(2);
+    BOOST_CHECK(pool.submit(isRegistered).get());
+  }
+  {
+    ThreadPool<LockFreeLocalWorkQueue> pool(2);
+    BOOST_CHECK(!pool.submit(isRegistered).get());
+  }
+  {
+    ThreadPool<QuiescentLockFreeLocalWorkQueue> pool(2);
+    BOOST_CHECK(pool.submit(isRegistered).get());
+  }
+}
+
+template <typename T, typename LocalWorkQueueType = LockFreeLocalWorkQueue>
 struct sorter
 {
-  ThreadPool<LockFreeLocalWorkQueue> pool;
+  ThreadPool<LocalWorkQueueType> pool;
   std::list<T> sort(std::list<T>& data)
   {
     using namespace std::literals::chrono_literals;
@@ -60,14 +78,14 @@ struct sorter
     return result;
   }
 };
-template <typename T>
+template <typename T, typename LocalWorkQueueType = LockFreeLocalWorkQueue>
 std::list<T> parallel_quick_sort(std::list<T> input)
 {
   if(input.empty())
   {
     return input;
   }
-  sorter<T> s;
+  sorter<T, LocalWorkQueueType> s;
   return s.sort(input);
 }
 
@@ -96,3 +114,42 @@ BOOST_AUTO_TEST_CASE(TestParallelQuickSort)
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestParallelQuickSortEpochBasedReclamation)
+{
+  std::size_t len = 10000;
+  std::random_device rnd;
+  std::mt19937 engine(rnd());
+  std::uniform_int_distribution<int> dist(-1000, 1000);
+  for(std::size_t i = 0; i < 10; ++i)
+  {
+    std::list<int> ls;
+    for(std::size_t j = 0; j < len; ++j)
+    {
+      ls.push_back(dist(engine));
+    }
+    std::vector<int> expected(ls.begin(), ls.end());
+    std::sort(expected.begin(), expected.end());
+    auto actual = parallel_quick_sort<int, BasicLockFreeLocalWorkQueue<EpochDomain>>(ls);
+    BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(), expected.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelQuickSortQuiescentStateBasedReclamation)
+{
+  std::size_t len = 10000;
+  std::random_device rnd;
+  std::mt19937 engine(rnd());
+  std::uniform_int_distribution<int> dist(-1000, 1000);
+  for(std::size_t i = 0; i < 10; ++i)
+  {
+    std::list<int> ls;
+    for(std::size_t j = 0; j < len; ++j)
+    {
+      ls.push_back(dist(engine));
+    }
+    std::vector<int> expected(ls.begin(), ls.end());
+    std::sort(expected.begin(), expected.end());
+    auto actual = parallel_quick_sort<int, QuiescentLockFreeLocalWorkQueue>(ls);
+    BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(), expected.end());
+  }
+}
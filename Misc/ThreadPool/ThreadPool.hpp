@@ -10,6 +10,8 @@
 #include <type_traits>
 #include <cassert>
 #include "HazardPointer.hpp"
+#include "EpochBasedReclamation.hpp"
+#include "QuiescentStateBasedReclamation.hpp"
 
 class jthread
 {
@@ -136,7 +138,8 @@ public:
   }
 };
 
-class LockFreeLocalWorkQueue
+template <typename Reclaimer>
+class BasicLockFreeLocalWorkQueue
 {
 private:
   class CircularArray
@@ -176,12 +179,14 @@ private:
   std::atomic<CircularArray*> mTasks;
   std::atomic<long long> mBottom;
   std::atomic<long long> mTop;
+  Reclaimer& mReclaimer;
 public:
-  LockFreeLocalWorkQueue(std::size_t initialCapacity = 1 << 3)
+  BasicLockFreeLocalWorkQueue(std::size_t initialCapacity = 1 << 3, Reclaimer& reclaimer = Reclaimer::defaultDomain())
     : mTasks(new CircularArray(initialCapacity))
     , mBottom(0)
-    , mTop(0) {}
-  ~LockFreeLocalWorkQueue() { delete mTasks.exchange(nullptr, std::memory_order_relaxed); }
+    , mTop(0)
+    , mReclaimer(reclaimer) {}
+  ~BasicLockFreeLocalWorkQueue() { delete mTasks.exchange(nullptr, std::memory_order_relaxed); }
   void push(Task&& task)
   {
     auto b = mBottom.load();
@@ -193,7 +198,7 @@ public:
       auto newTasks = mTasks.load()->resize(b, t);
       // safe to use store instead of exchange because push is called by only one specific thread
       mTasks.store(newTasks.get());
-      HazardPointerDomain<>::retire(tasks, &CircularArray::deleter);
+      mReclaimer.retire(tasks, &CircularArray::deleter);
       tasks = newTasks.release();
     }
     tasks->put(b, std::move(task));
@@ -212,7 +217,7 @@ public:
       mBottom.store(oldTop);
       return false;
     }
-    auto hpHolder = HazardPointerHolder(HazardPointerDomain<>::getHazardPointerForCurrentThread());
+    auto hpHolder = mReclaimer.makeHolder();
     auto tasks = claimPointer(mTasks, hpHolder);
     auto p = tasks->get(newBottom);
     if (0 < size)
@@ -243,7 +248,7 @@ public:
     {
       return false;
     }
-    HazardPointerHolder hpHolder(HazardPointerDomain<>::getHazardPointerForCurrentThread());
+    auto hpHolder = mReclaimer.makeHolder();
     auto tasks = claimPointer(mTasks, hpHolder);
     auto p = tasks->get(oldTop);
     if (mTop.compare_exchange_strong(oldTop, oldTop + 1))
@@ -257,7 +262,13 @@ public:
   }
 };
 
-template <typename LocalWorkQueueType = LocalWorkQueue>
+using LockFreeLocalWorkQueue = BasicLockFreeLocalWorkQueue<HazardPointerDomain<>>;
+using QuiescentLockFreeLocalWorkQueue = BasicLockFreeLocalWorkQueue<QuiescentStateDomain>;
+
+// If QuiescentWorkers is true, the workers register with QuiescentStateDomain and announce a quiescent state after every task,
+// so structures using the domain are read from tasks without entering a critical section per access.
+// It is independent of the local queue, and only on by default for QuiescentLockFreeLocalWorkQueue.
+template <typename LocalWorkQueueType = LocalWorkQueue, bool QuiescentWorkers = std::is_same_v<LocalWorkQueueType, QuiescentLockFreeLocalWorkQueue>>
 class ThreadPool
 {
 private:
@@ -272,9 +283,24 @@ private:
   {
     sIndex = i;
     sLocalWorkQueue = mLocalTasks[i].get();
+    // a worker holds no reference to shared nodes between tasks, so structures using QuiescentStateDomain are read without any per access cost in tasks.
+    // Only this loop announces quiescent states, a nested runPendingTask in a task does not, so a task may keep references across it.
+    // A task must not keep a reference after it returns, since the node may be freed once this worker announces its next quiescent state.
+    if constexpr(QuiescentWorkers)
+    {
+      QuiescentStateDomain::registerThread();
+    }
     while(!mDone)
     {
       runPendingTask();
+      if constexpr(QuiescentWorkers)
+      {
+        QuiescentStateDomain::quiescentState();
+      }
+    }
+    if constexpr(QuiescentWorkers)
+    {
+      QuiescentStateDomain::unregisterThread();
     }
   }
   bool getFromLocalQueue(Task& task)
@@ -355,7 +381,7 @@ public:
   }
 };
 
-template <typename LocalWorkQueueType>
-thread_local int ThreadPool<LocalWorkQueueType>::sIndex = 0;
-template <typename LocalWorkQueueType>
-thread_local LocalWorkQueueType* ThreadPool<LocalWorkQueueType>::sLocalWorkQueue = nullptr;
+template <typename LocalWorkQueueType, bool QuiescentWorkers>
+thread_local int ThreadPool<LocalWorkQueueType, QuiescentWorkers>::sIndex = 0;
+template <typename LocalWorkQueueType, bool QuiescentWorkers>
+thread_local LocalWorkQueueType* ThreadPool<LocalWorkQueueType, QuiescentWorkers>::sLocalWorkQueue = nullptr;